@@ -0,0 +1,37 @@
+# Script behind the bench target, run with cmake -P. Expects APP, CONFIG, OUTPUT_DIR, PGO_PROFILE_DIR and, for Clang
+# PGO, LLVM_PROFDATA.
+
+# A profile from an earlier build of the instrumented binary would not match this one.
+if (CONFIG STREQUAL "PGOGenerate")
+    file(REMOVE_RECURSE "${PGO_PROFILE_DIR}")
+    file(MAKE_DIRECTORY "${PGO_PROFILE_DIR}")
+    set(ENV{LLVM_PROFILE_FILE} "${PGO_PROFILE_DIR}/bench-%p.profraw")
+endif()
+
+# The triangle scene and the virtual texture cover the plain draw path and the streaming path.
+foreach(SCENE scene virtual_texture)
+    set(ARGS --record-reference "${OUTPUT_DIR}/${SCENE}" --no-validation)
+    if (SCENE STREQUAL "virtual_texture")
+        list(APPEND ARGS --virtual-texture)
+    endif()
+
+    file(MAKE_DIRECTORY "${OUTPUT_DIR}/${SCENE}")
+    message(STATUS "bench ${SCENE} (${CONFIG})")
+    execute_process(COMMAND "${APP}" ${ARGS} RESULT_VARIABLE RESULT)
+    if (NOT RESULT EQUAL 0)
+        message(FATAL_ERROR "bench ${SCENE} failed: ${RESULT}")
+    endif()
+endforeach()
+
+if (CONFIG STREQUAL "PGOGenerate" AND LLVM_PROFDATA)
+    file(GLOB PROFILES "${PGO_PROFILE_DIR}/*.profraw")
+    execute_process(COMMAND "${LLVM_PROFDATA}" merge -output=${PGO_PROFILE_DIR}/default.profdata ${PROFILES}
+                    RESULT_VARIABLE RESULT)
+    if (NOT RESULT EQUAL 0)
+        message(FATAL_ERROR "merging the profile failed: ${RESULT}")
+    endif()
+endif()
+
+if (CONFIG STREQUAL "PGOGenerate")
+    message(STATUS "profile written to ${PGO_PROFILE_DIR}, reconfigure with -DCMAKE_BUILD_TYPE=PGOUse and rebuild")
+endif()
@@ -0,0 +1,23 @@
+# Script behind the device_loss_recovery test, run with cmake -P. Expects APP and OUTPUT_DIR.
+#
+# Records the headless reference sequence, then renders it again with a device loss injected every 7 frames, which
+# lands on the captured frames 7 and 63 among others. Passes when the app recovered and every captured frame still
+# matches its golden image. Frame times are not compared: the rebuilds disturb them on purpose.
+
+file(REMOVE_RECURSE "${OUTPUT_DIR}")
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+
+execute_process(COMMAND "${APP}" --record-reference "${OUTPUT_DIR}" --no-validation RESULT_VARIABLE RESULT)
+if (NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "recording the reference failed: ${RESULT}")
+endif()
+
+execute_process(COMMAND "${APP}" --reference "${OUTPUT_DIR}" --inject-device-lost 7 --frame-time-tolerance 1000 --no-validation
+                RESULT_VARIABLE RESULT OUTPUT_VARIABLE OUTPUT ERROR_VARIABLE OUTPUT)
+message("${OUTPUT}")
+if (NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "reference run with injected device loss failed: ${RESULT}")
+endif()
+if (NOT OUTPUT MATCHES "recoverFromDeviceLoss - recovery [0-9]+:")
+    message(FATAL_ERROR "no device loss recovery was reported")
+endif()
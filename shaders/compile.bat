@@ -1,3 +1,10 @@
 C:/VulkanSDK/1.3.231.1/Bin/glslc.exe shader_base.vert -o vert.spv
 C:/VulkanSDK/1.3.231.1/Bin/glslc.exe shader_base.frag -o frag.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe shader_mesh.vert -o mesh_vert.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe mesh_decode.comp -o mesh_decode.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe meshlet_cull.comp -o meshlet_cull.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe --target-env=vulkan1.2 meshlet.task -o meshlet_task.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe --target-env=vulkan1.2 meshlet.mesh -o meshlet_mesh.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe virtual_texture.vert -o virtual_texture_vert.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe virtual_texture.frag -o virtual_texture_frag.spv
 pause
\ No newline at end of file
@@ -0,0 +1,81 @@
+// Shared by meshlet_cull.comp, meshlet.task and meshlet.mesh. Layouts match src/mesh_format.h.
+
+struct Meshlet {
+    uint indexOffset;
+    uint triangleCount;
+    uint vertexCount;
+    uint vertexOffset;
+};
+
+struct MeshletBounds {
+    vec4 sphere; // center, radius
+    vec4 cone;   // axis, cutoff
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Vertices {
+    float vertexData[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer MeshletVertices {
+    uint meshletVertices[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer Bounds {
+    MeshletBounds bounds[];
+};
+
+layout(std430, set = 0, binding = 4) readonly buffer MeshletTriangles {
+    uint meshletTriangles[];
+};
+
+layout(push_constant) uniform CullParams {
+    mat4 mvp;
+    vec4 cameraPosition; // object space
+    uint meshletCount;
+} params;
+
+bool isMeshletVisible(uint meshletIndex) {
+    vec3 center = bounds[meshletIndex].sphere.xyz;
+    float radius = bounds[meshletIndex].sphere.w;
+
+    // Frustum planes extracted from the object space mvp, Vulkan clip space so the near plane is z >= 0.
+    vec4 row0 = vec4(params.mvp[0][0], params.mvp[1][0], params.mvp[2][0], params.mvp[3][0]);
+    vec4 row1 = vec4(params.mvp[0][1], params.mvp[1][1], params.mvp[2][1], params.mvp[3][1]);
+    vec4 row2 = vec4(params.mvp[0][2], params.mvp[1][2], params.mvp[2][2], params.mvp[3][2]);
+    vec4 row3 = vec4(params.mvp[0][3], params.mvp[1][3], params.mvp[2][3], params.mvp[3][3]);
+    vec4 planes[6] = vec4[](row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2);
+
+    for (int i = 0; i < 6; ++i) {
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz)) {
+            return false;
+        }
+    }
+
+    // Backface cone.
+    vec3 cameraToCenter = center - params.cameraPosition.xyz;
+    vec4 cone = bounds[meshletIndex].cone;
+    return dot(cameraToCenter, cone.xyz) < cone.w * length(cameraToCenter) + radius;
+}
+
+vec3 loadPosition(uint vertexIndex) {
+    uint base = vertexIndex * 9;
+    return vec3(vertexData[base + 0], vertexData[base + 1], vertexData[base + 2]);
+}
+
+vec3 loadNormal(uint vertexIndex) {
+    uint base = vertexIndex * 9;
+    return vec3(vertexData[base + 3], vertexData[base + 4], vertexData[base + 5]);
+}
+
+vec3 loadColor(uint vertexIndex) {
+    uint base = vertexIndex * 9;
+    return vec3(vertexData[base + 6], vertexData[base + 7], vertexData[base + 8]);
+}
+
+uint loadMeshletTriangleIndex(uint byteOffset) {
+    return (meshletTriangles[byteOffset >> 2] >> ((byteOffset & 3u) * 8u)) & 0xFFu;
+}
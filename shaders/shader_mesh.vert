@@ -0,0 +1,18 @@
+#version 450
+
+layout(push_constant) uniform MeshPushConstants {
+    mat4 mvp;
+} pushConstants;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = pushConstants.mvp * vec4(inPosition, 1.0);
+
+    float diffuse = max(dot(normalize(inNormal), normalize(vec3(0.4, 0.8, 0.4))), 0.0);
+    fragColor = inColor * (0.25 + 0.75 * diffuse);
+}
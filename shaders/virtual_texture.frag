@@ -0,0 +1,68 @@
+#version 450
+
+// Mirrors src/virtual_texture.h.
+#define VT_VIRTUAL_SIZE 16384.0
+#define VT_PAGE_SIZE 128.0
+#define VT_MIP_COUNT 8
+#define VT_PAGES_PER_SIDE 128
+#define VT_PAGE_BORDER 4.0
+#define VT_SLOT_SIZE 136.0
+#define VT_POOL_SLOTS_PER_SIDE 16.0
+
+layout(push_constant) uniform VirtualTexturePushConstants {
+    mat4 mvp;
+    uint feedbackStamp;
+    uint sparse;
+} pushConstants;
+
+// RGBA8 per page: slot x, slot y, resident mip.
+layout(set = 0, binding = 0) uniform sampler2D pageTable;
+// The sparse virtual image itself, or the pool of bordered pages.
+layout(set = 0, binding = 1) uniform sampler2D physicalTexture;
+
+// Stamped with the frame for every page a fragment wanted, read back by the residency manager.
+layout(std430, set = 0, binding = 2) writeonly buffer Feedback {
+    uint pageRequests[];
+};
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+uint mipPageOffset(int mip) {
+    uint offset = 0;
+    for (int i = 0; i < mip; ++i) {
+        uint pagesPerSide = uint(VT_PAGES_PER_SIDE >> i);
+        offset += pagesPerSide * pagesPerSide;
+    }
+    return offset;
+}
+
+void main() {
+    vec2 texel = fragTexCoord * VT_VIRTUAL_SIZE;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = clamp(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), 0.0, float(VT_MIP_COUNT - 1));
+    int requestedMip = int(lod);
+
+    int pagesPerSide = VT_PAGES_PER_SIDE >> requestedMip;
+    ivec2 page = clamp(ivec2(fragTexCoord * float(pagesPerSide)), ivec2(0), ivec2(pagesPerSide - 1));
+
+    // One pixel in each 4x4 block reports per frame, rotating so the whole screen is covered every 16 frames.
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    if (uint(pixel.y * 4 + pixel.x) == (pushConstants.feedbackStamp & 15u)) {
+        pageRequests[mipPageOffset(requestedMip) + uint(page.y * pagesPerSide + page.x)] = pushConstants.feedbackStamp;
+    }
+
+    uvec4 entry = uvec4(texelFetch(pageTable, page, requestedMip) * 255.0 + 0.5);
+
+    if (pushConstants.sparse != 0u) {
+        // A whole mip with nearest mip selection, so only the bound resident level is read, never the one below it.
+        // Neighbouring pages at that mip may still be unbound, filtering across them can show at page edges.
+        outColor = textureLod(physicalTexture, fragTexCoord, float(max(requestedMip, int(entry.b))));
+    } else {
+        vec2 pageTexCoord = fract(fragTexCoord * float(VT_PAGES_PER_SIDE >> entry.b));
+        vec2 poolTexel = vec2(entry.rg) * VT_SLOT_SIZE + VT_PAGE_BORDER + pageTexCoord * VT_PAGE_SIZE;
+        outColor = textureLod(physicalTexture, poolTexel / (VT_SLOT_SIZE * VT_POOL_SLOTS_PER_SIDE), 0.0);
+    }
+}
@@ -0,0 +1,21 @@
+#version 450
+
+layout(push_constant) uniform VirtualTexturePushConstants {
+    mat4 mvp;
+    uint feedbackStamp;
+    uint sparse;
+} pushConstants;
+
+layout(location = 0) out vec2 fragTexCoord;
+
+// A 64 x 64 ground plane around the origin, the whole virtual texture stretched over it.
+const vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+    vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0)
+);
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    gl_Position = pushConstants.mvp * vec4((corner.x - 0.5) * 64.0, 0.0, (corner.y - 0.5) * 64.0, 1.0);
+    fragTexCoord = corner;
+}
@@ -0,0 +1,69 @@
+#include "dynamic_resolution.h"
+
+#include <math.h>
+#include <string.h>
+
+void initDynamicResolution(DynamicResolution* pController, double budgetMs) {
+    memset(pController, 0, sizeof(*pController));
+    pController->budgetMs = budgetMs;
+    pController->scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+    resetDynamicResolutionStats(pController);
+}
+
+void resetDynamicResolutionStats(DynamicResolution* pController) {
+    memset(&pController->stats, 0, sizeof(pController->stats));
+    pController->stats.minScale = pController->scale;
+    pController->stats.maxScale = pController->scale;
+}
+
+void updateDynamicResolution(DynamicResolution* pController, uint64_t frame, double gpuMs, uint32_t width, uint32_t height) {
+    DynamicResolutionStats* pStats = &pController->stats;
+    pStats->frameCount++;
+    pStats->totalGpuMs += gpuMs;
+    pStats->maxGpuMs = gpuMs > pStats->maxGpuMs ? gpuMs : pStats->maxGpuMs;
+    if (gpuMs > pController->budgetMs) {
+        pStats->overBudgetCount++;
+    }
+
+    if (pController->pTraceFile != NULL) {
+        fprintf(pController->pTraceFile, "%llu,%.4f,%.4f,%u,%u\n", (unsigned long long) frame, gpuMs, pController->scale, width, height);
+    }
+
+    const double cost = gpuMs / (pController->scale * pController->scale);
+    pController->fullScaleCostMs = pController->fullScaleCostMs == 0.0
+            ? cost
+            : pController->fullScaleCostMs + DYNAMIC_RESOLUTION_SMOOTHING * (cost - pController->fullScaleCostMs);
+    if (pController->fullScaleCostMs <= 0.0) {
+        return;
+    }
+
+    double target = sqrt(pController->budgetMs * DYNAMIC_RESOLUTION_HEADROOM / pController->fullScaleCostMs);
+    double low = pController->scale * (1.0 - DYNAMIC_RESOLUTION_MAX_STEP);
+    double high = pController->scale * (1.0 + DYNAMIC_RESOLUTION_MAX_STEP);
+    target = target < low ? low : (target > high ? high : target);
+    target = target < DYNAMIC_RESOLUTION_MIN_SCALE ? DYNAMIC_RESOLUTION_MIN_SCALE : target;
+    target = target > DYNAMIC_RESOLUTION_MAX_SCALE ? DYNAMIC_RESOLUTION_MAX_SCALE : target;
+
+    // Always settle on the limits, even when they are within the dead band.
+    if (fabs(target - pController->scale) >= DYNAMIC_RESOLUTION_DEAD_BAND * pController->scale ||
+        target == DYNAMIC_RESOLUTION_MIN_SCALE || target == DYNAMIC_RESOLUTION_MAX_SCALE) {
+        pController->scale = target;
+    }
+
+    pStats->minScale = pController->scale < pStats->minScale ? pController->scale : pStats->minScale;
+    pStats->maxScale = pController->scale > pStats->maxScale ? pController->scale : pStats->maxScale;
+}
+
+void getDynamicResolutionExtent(const DynamicResolution* pController, uint32_t fullWidth, uint32_t fullHeight,
+                                uint32_t* pWidth, uint32_t* pHeight) {
+    if (pController->scale >= DYNAMIC_RESOLUTION_MAX_SCALE) {
+        *pWidth = fullWidth;
+        *pHeight = fullHeight;
+        return;
+    }
+
+    uint32_t width = (uint32_t) (fullWidth * pController->scale) & ~1u;
+    uint32_t height = (uint32_t) (fullHeight * pController->scale) & ~1u;
+    *pWidth = width < 2 ? 2 : (width > fullWidth ? fullWidth : width);
+    *pHeight = height < 2 ? 2 : (height > fullHeight ? fullHeight : height);
+}
@@ -0,0 +1,54 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Render scale per axis, relative to the swapchain extent.
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5
+#define DYNAMIC_RESOLUTION_MAX_SCALE 1.0
+// The controller aims this far under the budget so frame to frame noise does not push frames over it.
+#define DYNAMIC_RESOLUTION_HEADROOM 0.9
+// Weight of the newest frame in the smoothed cost.
+#define DYNAMIC_RESOLUTION_SMOOTHING 0.2
+// Largest relative change of the scale in one frame, so a single spike does not collapse the resolution.
+#define DYNAMIC_RESOLUTION_MAX_STEP 0.05
+// Smaller relative changes are ignored, otherwise the resolution moves by a pixel every frame.
+#define DYNAMIC_RESOLUTION_DEAD_BAND 0.02
+
+// Extremes since the last report, for tuning.
+typedef struct DynamicResolutionStats {
+    uint32_t frameCount;
+    uint32_t overBudgetCount;
+    double totalGpuMs;
+    double maxGpuMs;
+    double minScale;
+    double maxScale;
+} DynamicResolutionStats;
+
+// Holds a GPU frame time budget by scaling the render resolution. GPU time is modelled as proportional to the
+// rendered pixel count, so each frame's time divided by scale^2 estimates the cost at full resolution; the smoothed
+// estimate then gives the scale that fits the budget.
+typedef struct DynamicResolution {
+    double budgetMs;
+    double scale;
+    // Smoothed GPU time the frame would take at scale 1, 0 before the first measurement.
+    double fullScaleCostMs;
+    DynamicResolutionStats stats;
+    // One CSV line per measured frame when set.
+    FILE* pTraceFile;
+} DynamicResolution;
+
+void initDynamicResolution(DynamicResolution* pController, double budgetMs);
+
+// Feeds the GPU time of a frame rendered at width x height with the current scale and moves the scale for the next
+// frame. The trace line is written with the values the frame was rendered at.
+void updateDynamicResolution(DynamicResolution* pController, uint64_t frame, double gpuMs, uint32_t width, uint32_t height);
+
+// Scaled extent, rounded down to even sizes so a 2x upscale lines up, and at least 2 x 2.
+void getDynamicResolutionExtent(const DynamicResolution* pController, uint32_t fullWidth, uint32_t fullHeight,
+                                uint32_t* pWidth, uint32_t* pHeight);
+
+void resetDynamicResolutionStats(DynamicResolution* pController);
+
+#endif //DYNAMIC_RESOLUTION_H
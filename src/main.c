@@ -1,19 +1,306 @@
+#include "vulkan_dispatch.h"
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <math.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 
-typedef struct AppState {
+#include "dynamic_resolution.h"
+#include "mesh_format.h"
+#include "mpsc_queue.h"
+#include "platform.h"
+#include "reference.h"
+#include "resource_manifest.h"
+#include "vec_math.h"
+#include "virtual_texture.h"
+
+#define UPLOAD_SLOT_COUNT 2
+#define UPLOAD_SLOT_SIZE (4 * 1024 * 1024)
+
+// Must match local_size_x in mesh_decode.comp.
+#define MESH_DECODE_GROUP_SIZE 64
+// Must match local_size_x in meshlet_cull.comp and meshlet.task.
+#define MESHLET_CULL_GROUP_SIZE 64
+#define MESHLET_TASK_GROUP_SIZE 32
+
+#define TIMESTAMP_QUERY_COUNT 2
+// Frames between the statistics printouts.
+#define STATISTICS_REPORT_FRAMES 500
+
+#define TIMELINE_FENCE_RING_SIZE 8
+#define TIMELINE_MAX_WAITS 4
+
+#define SUBMIT_MAX_PENDING_BATCHES 32
+#define SUBMIT_FLUSH_WINDOW_SECONDS 0.002
+#define SUBMIT_IDLE_WAKE_SECONDS 0.1
+
+#define PIPELINE_CACHE_FILENAME "pipeline_cache.bin"
+
+// An idle window still wakes this often to report utilisation and notice a lost device.
+#define IDLE_WAIT_TIMEOUT_SECONDS 0.5
+#define UTILISATION_REPORT_SECONDS 5.0
+
+// Monotonic count of the batches submitted to one queue. Every submit signals the next value, and anything that
+// has to wait for GPU work, on the CPU or on another queue, names the value it needs instead of holding a fence or
+// semaphore of its own. Backed by a timeline semaphore, or by a ring of fences when timelines are unavailable.
+typedef struct QueueTimeline {
+    VkQueue queue;
+    VkSemaphore semaphore;
+    _Atomic uint64_t lastSubmittedValue;
+    _Atomic uint64_t completedValue;
+    VkFence fences[TIMELINE_FENCE_RING_SIZE];
+    uint64_t fenceValues[TIMELINE_FENCE_RING_SIZE];
+} QueueTimeline;
+
+typedef struct TimelineWait {
+    QueueTimeline* pTimeline;
+    uint64_t value;
+    VkPipelineStageFlags stageMask;
+} TimelineWait;
+
+// One batch: its command buffers, the timeline points it depends on, and the binary semaphores the swapchain and
+// sparse binding still need.
+typedef struct QueueSubmitDesc {
+    uint32_t commandBufferCount;
+    const VkCommandBuffer* pCommandBuffers;
+    uint32_t waitCount;
+    const TimelineWait* pWaits;
+    VkSemaphore binaryWaitSemaphore;
+    VkPipelineStageFlags binaryWaitStageMask;
+    VkSemaphore binarySignalSemaphore;
+} QueueSubmitDesc;
+
+// A batch handed to the submit layer. The producer owns it and everything it points at, and may only refill it once
+// waitForSubmitBatch has returned.
+typedef struct SubmitBatch {
+    // First member, the submit thread casts popped nodes back to the batch.
+    MpscNode node;
+    QueueSubmitDesc desc;
+    // Optional sparse binding issued ahead of the submit call that carries desc.
+    const VkBindSparseInfo* pBindSparseInfo;
+    // Presents imageIndex once submitted, waiting on desc.binarySignalSemaphore. A presenting batch closes the
+    // flush window.
+    bool present;
+    uint32_t imageIndex;
+    VkResult presentResult;
+    // Set before pending is cleared, 0 for a batch that was never enqueued.
+    uint64_t timelineValue;
+    _Atomic bool pending;
+} SubmitBatch;
+
+// The one owner of the graphics queue while the frame loop runs. Producers push batches from any thread; the submit
+// thread collects everything that arrives within a flush window into a single vkQueueSubmit, then presents.
+typedef struct SubmitQueue {
+    MpscQueue queue;
+    PlatformThread* pThread;
+    PlatformSemaphore* pWakeSemaphore;
+    // Posted by the submit thread after each flush, so producers waiting for a batch sleep instead of spinning.
+    PlatformSemaphore* pDoneSemaphore;
+    _Atomic bool flushRequested;
+    _Atomic bool stopRequested;
+    _Atomic uint64_t submitCallCount;
+    _Atomic uint64_t batchCount;
+    // CPU time the submit thread used, valid once it has been stopped.
+    double threadCpuSeconds;
+} SubmitQueue;
+
+// A scene draw places the base triangle through its viewport so a stack of draws can overlap at different depths.
+typedef struct SceneDraw {
+    float x;
+    float y;
+    float scale;
+    float depth;
+    uint32_t pipelineIndex;
+} SceneDraw;
+
+// Fixed size staging memory that all buffer uploads are streamed through, split into slots that are filled and
+// copied in turn.
+typedef struct UploadContext {
+    VkDeviceSize slotSize;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    uint8_t* pStagingData;
+    VkCommandBuffer commandBuffers[UPLOAD_SLOT_COUNT];
+    // Timeline value that frees each slot.
+    uint64_t slotValues[UPLOAD_SLOT_COUNT];
+    uint32_t nextSlot;
+    VkDeviceSize uploadedBytes;
+    // When set, each upload samples the heap so a benchmark can see the peak while a loader holds its source data.
+    bool trackHeapPeak;
+    size_t peakHeapBytes;
+} UploadContext;
+
+// How a loaded mesh is drawn: as one indexed draw, as per meshlet indirect draws written by a culling dispatch, or
+// through task and mesh shaders that cull and emit meshlets themselves.
+typedef enum MeshletMode {
+    MESHLET_MODE_NONE,
+    MESHLET_MODE_COMPUTE_CULL,
+    MESHLET_MODE_MESH_SHADER,
+} MeshletMode;
+
+typedef struct GpuBuffer {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+} GpuBuffer;
+
+typedef struct GpuMesh {
+    VkBuffer vertexBuffer;
+    VkDeviceMemory vertexBufferMemory;
+    VkDeviceSize vertexDataSize;
+    VkBuffer indexBuffer;
+    VkDeviceMemory indexBufferMemory;
+    VkDeviceSize indexDataSize;
+    VkIndexType indexType;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+
+    // Only present when the file has the meshlet sections.
+    uint32_t meshletCount;
+    GpuBuffer meshletBuffer;
+    GpuBuffer meshletBoundsBuffer;
+    GpuBuffer meshletVertexBuffer;
+    GpuBuffer meshletTriangleBuffer;
+    GpuBuffer drawCommandBuffer;
+} GpuMesh;
+
+typedef struct MeshDecodePushConstants {
+    float boundsMin[4];
+    float boundsExtent[4];
+    uint32_t vertexCount;
+} MeshDecodePushConstants;
+
+// Must match CullParams in meshlet_common.glsl.
+typedef struct MeshletPushConstants {
+    Mat4 mvp;
+    float cameraPosition[4];
+    uint32_t meshletCount;
+} MeshletPushConstants;
+
+// GPU side of the virtual texture: the physical pages (a sparse image or a pool of bordered slots), the page table
+// the shader translates through, the feedback buffer it writes and the staging used to page in.
+typedef struct VirtualTextureResources {
+    VirtualTexture* pResidency;
+    bool sparse;
+
+    VkImage physicalImage;
+    VkDeviceMemory physicalMemory;
+    VkDeviceSize physicalMemorySize;
+    VkDeviceSize sparsePageSize;
+    VkImageView physicalImageView;
+
+    VkImage pageTableImage;
+    VkDeviceMemory pageTableMemory;
+    VkImageView pageTableImageView;
+
+    VkSampler linearSampler;
+    VkSampler nearestSampler;
+
+    VkBuffer feedbackBuffer;
+    VkDeviceMemory feedbackMemory;
+    uint32_t* pFeedback;
+    // Stamp written by the most recently recorded frame, 0 before the first one.
+    uint32_t feedbackStamp;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    uint8_t* pStagingData;
+    VkCommandBuffer commandBuffer;
+    VkSemaphore bindSemaphore;
+    VkSparseImageMemoryBind sparseBinds[2 * VT_MAX_PAGE_INS_PER_FRAME];
+    VkSparseImageMemoryBindInfo sparseImageBindInfo;
+    VkBindSparseInfo bindSparseInfo;
+    SubmitBatch uploadBatch;
+
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout pipelineLayout;
+    VkDescriptorSet descriptorSet;
+    VkPipeline pipeline;
+} VirtualTextureResources;
+
+// Must match VirtualTexturePushConstants in virtual_texture.vert and virtual_texture.frag.
+typedef struct VirtualTexturePushConstants {
+    Mat4 mvp;
+    uint32_t feedbackStamp;
+    uint32_t sparse;
+} VirtualTexturePushConstants;
+
+// What the frame loop did since the last utilisation report.
+typedef struct FrameActivity {
+    double startTime;
+    double startCpuSeconds;
+    double gpuSeconds;
+    uint32_t renderedFrames;
+    uint32_t representedFrames;
+} FrameActivity;
+
+// What the command line asked for. Init may turn off a feature the device lacks, but otherwise these do not change,
+// and they survive device loss recovery.
+typedef struct AppOptions {
     int screenWidth;
     int screenHeight;
 
     bool enableValidationLayers;
-
+    bool enableDepthPrePass;
+    bool enableFrontToBackSort;
+    bool enableMeshlets;
+    bool enableMeshShader;
+    bool enableVirtualTexture;
+    bool enableSparseResidency;
+    bool enableTimelineSemaphore;
+    bool enableSubmitThread;
+    // No window, surface or swapchain: frames render into an offscreen image that can be read back.
+    bool headless;
+    // Only render when the image would change, and block on window events otherwise.
+    bool enableIdle;
+    // Render into an offscreen target scaled to hold the frame budget and upscale it into the swapchain image.
+    bool enableDynamicResolution;
+
+    const char* meshFilename;
+    const char* benchMeshFilename;
+    const char* benchRawMeshFilename;
+    bool benchSync;
+    bool benchSubmit;
+    bool benchDrawCalls;
+    const char* referenceDirectory;
+    bool recordReference;
+    double frameTimeTolerance;
+    // Simulates a device loss every this many frames, 0 for never.
+    uint32_t injectDeviceLostInterval;
+} AppOptions;
+
+// Everything about the run that outlives a device: the window, counters and statistics, and what is needed to
+// rebuild the device after it is lost.
+typedef struct AppRun {
     GLFWwindow *pWindow;
+    bool windowIconified;
+    uint64_t frameCount;
+    double startTime;
+    // Set for frames whose output is copied into the readback buffer. Kept across a rebuild so a frame lost and
+    // rendered again during recovery is still captured.
+    bool captureFrame;
+    FrameActivity activity;
+    DynamicResolution dynamicResolution;
+
+    // Every object initVulkan created, replayed to rebuild the device after it is lost.
+    ResourceManifest manifest;
+    void* pPipelineCacheData;
+    size_t pipelineCacheDataSize;
+    uint64_t lastInjectedFrame;
+    uint32_t recoveryCount;
+} AppRun;
+
+typedef struct AppState {
+    AppOptions options;
+    AppRun run;
 
+    // Everything from the instance on belongs to the device and is zeroed when it is rebuilt, see resetDeviceState.
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;
     VkSurfaceKHR surface;
@@ -23,6 +310,7 @@ typedef struct AppState {
 
     VkQueue queue;
     uint32_t graphicsQueueFamilyIndex;
+    VkQueueFlags queueFlags;
 
     VkSwapchainKHR swapChain;
     uint32_t swapChainImageCount;
@@ -33,17 +321,88 @@ typedef struct AppState {
 
     VkFramebuffer *pSwapChainFramebuffers;
 
+    // Area the frame is rendered into: the swapchain extent, or the dynamic resolution's share of the offscreen target,
+    // which is allocated at the swapchain extent.
+    VkExtent2D renderExtent;
+    VkImage offscreenImage;
+    VkDeviceMemory offscreenImageMemory;
+    VkImageView offscreenImageView;
+    VkFramebuffer offscreenFramebuffer;
+
+    // Bumped by anything that changes what the next frame would show. Each swapchain image remembers the generation
+    // it was last rendered with, UINT64_MAX before the first time.
+    uint64_t contentGeneration;
+    uint64_t *pSwapChainImageGenerations;
+    uint64_t presentedGeneration;
+    // The window system lost the window contents and wants them presented again.
+    bool presentRequested;
+    bool lastFrameRecorded;
+    // The recorded frame carries the pipeline statistics query, only true for frames right before a report.
+    bool statisticsQueryRecorded;
+
+    VkDeviceMemory headlessImageMemory;
+    VkBuffer readbackBuffer;
+    VkDeviceMemory readbackMemory;
+    uint8_t* pReadbackData;
+
+    VkFormat depthFormat;
+    VkImage depthImage;
+    VkDeviceMemory depthImageMemory;
+    VkImageView depthImageView;
+
     VkRenderPass renderPass;
     VkPipelineLayout pipelineLayout;
     VkPipeline graphicsPipeline;
+    VkPipeline depthPrePassPipeline;
+
+    VkDescriptorPool descriptorPool;
+    UploadContext upload;
+
+    GpuMesh mesh;
+    VkPipelineLayout meshPipelineLayout;
+    VkPipeline meshPipeline;
+    VkDescriptorSetLayout meshDecodeSetLayout;
+    VkPipelineLayout meshDecodePipelineLayout;
+    VkPipeline meshDecodePipeline;
+
+    bool meshShaderSupported;
+    bool multiDrawIndirectSupported;
+    uint32_t maxDrawIndirectCount;
+    MeshletMode meshletMode;
+    VkDescriptorSetLayout meshletSetLayout;
+    VkShaderStageFlags meshletShaderStages;
+    VkPipelineLayout meshletPipelineLayout;
+    VkDescriptorSet meshletDescriptorSet;
+    VkPipeline meshletCullPipeline;
+    VkPipeline meshletMeshShaderPipeline;
+
+    bool fragmentStoresSupported;
+    bool sparseResidencySupported;
+    VirtualTextureResources virtualTexture;
+
+    uint32_t sceneDrawCount;
+    SceneDraw *pSceneDraws;
+    uint64_t *pSceneSortKeys;
+
+    bool pipelineStatisticsSupported;
+    VkQueryPool statisticsQueryPool;
+    uint32_t timestampValidBits;
+    float timestampPeriod;
+    VkQueryPool timestampQueryPool;
 
     VkCommandPool commandPool;
     VkCommandBuffer commandBuffer;
 
+    bool timelineSemaphoreSupported;
+    QueueTimeline graphicsTimeline;
+    SubmitQueue submitQueue;
+    SubmitBatch frameBatch;
+
     VkSemaphore imageAvailableSemaphore;
     VkSemaphore renderFinishedSemaphore;
-    VkFence inFlightFence;
 
+    VkPipelineCache pipelineCache;
+    _Atomic bool deviceLost;
 } AppState;
 
 const uint32_t validationLayersCount = 1;
@@ -56,6 +415,24 @@ const char* requiredExtensions[] = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// The window callbacks only note what happened, the frame loop decides whether that needs a frame.
+static void windowRefreshCallback(GLFWwindow* pWindow) {
+    AppState* pState = glfwGetWindowUserPointer(pWindow);
+    pState->presentRequested = true;
+}
+
+static void windowIconifyCallback(GLFWwindow* pWindow, int iconified) {
+    AppState* pState = glfwGetWindowUserPointer(pWindow);
+    pState->run.windowIconified = iconified == GLFW_TRUE;
+}
+
+// Nothing reacts to input yet, so input still wakes the loop but never asks for a frame. An input handler that
+// changes the image has to bump contentGeneration like this does.
+static void framebufferSizeCallback(GLFWwindow* pWindow, int width, int height) {
+    AppState* pState = glfwGetWindowUserPointer(pWindow);
+    pState->contentGeneration++;
+}
+
 void initWindow(AppState* pState) {
     printf( "%s - initializing app window!\n", __FUNCTION__ );
 
@@ -64,25 +441,29 @@ void initWindow(AppState* pState) {
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-    pState->pWindow = glfwCreateWindow(pState->screenWidth, pState->screenHeight, "app", NULL, NULL);
-    if (pState->pWindow == NULL) {
+    pState->run.pWindow = glfwCreateWindow(pState->options.screenWidth, pState->options.screenHeight, "app", NULL, NULL);
+    if (pState->run.pWindow == NULL) {
         printf( "%s - unable to initialize GLFW Window!\n", __FUNCTION__ );
+        return;
     }
+
+    glfwSetWindowUserPointer(pState->run.pWindow, pState);
+    glfwSetWindowRefreshCallback(pState->run.pWindow, windowRefreshCallback);
+    glfwSetWindowIconifyCallback(pState->run.pWindow, windowIconifyCallback);
+    glfwSetFramebufferSizeCallback(pState->run.pWindow, framebufferSizeCallback);
 }
 
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
-    PFN_vkCreateDebugUtilsMessengerEXT func = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
-    if (func != NULL) {
-        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+    if (vkCreateDebugUtilsMessengerEXT != NULL) {
+        return vkCreateDebugUtilsMessengerEXT(instance, pCreateInfo, pAllocator, pDebugMessenger);
     } else {
         return VK_ERROR_EXTENSION_NOT_PRESENT;
     }
 }
 
 void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
-    PFN_vkDestroyDebugUtilsMessengerEXT func = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-    if (func != NULL) {
-        func(instance, debugMessenger, pAllocator);
+    if (vkDestroyDebugUtilsMessengerEXT != NULL) {
+        vkDestroyDebugUtilsMessengerEXT(instance, debugMessenger, pAllocator);
     }
 }
 
@@ -128,10 +509,13 @@ bool checkValidationLayerSupport() {
 
 void getRequiredExtensions(AppState *pState, uint32_t* extensionCount, const char** pExtensions) {
     uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char** glfwExtensions = NULL;
+    if (!pState->options.headless) {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    }
 
     if (pExtensions == NULL){
-        *extensionCount = glfwExtensionCount + (pState->enableValidationLayers ? 1 : 0);
+        *extensionCount = glfwExtensionCount + (pState->options.enableValidationLayers ? 1 : 0);
         return;
     }
 
@@ -139,14 +523,15 @@ void getRequiredExtensions(AppState *pState, uint32_t* extensionCount, const cha
         pExtensions[i] = glfwExtensions[i];
     }
 
-    if (pState->enableValidationLayers) {
+    if (pState->options.enableValidationLayers) {
         pExtensions[glfwExtensionCount] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
     }
 }
 
 void createInstance(AppState* pState) {
-    if (pState->enableValidationLayers && !checkValidationLayerSupport()) {
+    if (pState->options.enableValidationLayers && !checkValidationLayerSupport()) {
         printf( "%s - validation layers requested, but not available!\n", __FUNCTION__ );
+        pState->options.enableValidationLayers = false;
     }
 
     VkApplicationInfo appInfo = {
@@ -155,7 +540,7 @@ void createInstance(AppState* pState) {
         .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
         .pEngineName = NULL,
         .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-        .apiVersion = VK_API_VERSION_1_0,
+        .apiVersion = VK_API_VERSION_1_2,
     };
 
     VkInstanceCreateInfo createInfo = {
@@ -174,7 +559,7 @@ void createInstance(AppState* pState) {
     createInfo.enabledLayerCount = 0;
 
     VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo = {};
-    if (pState->enableValidationLayers) {
+    if (pState->options.enableValidationLayers) {
         createInfo.enabledLayerCount = validationLayersCount;
         createInfo.ppEnabledLayerNames = validationLayers;
 
@@ -188,10 +573,12 @@ void createInstance(AppState* pState) {
     if (vkCreateInstance(&createInfo, NULL, &pState->instance) != VK_SUCCESS) {
         printf( "%s - unable to initialize Vulkan!\n", __FUNCTION__ );
     }
+    loadInstanceFunctions(pState->instance);
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_INSTANCE, appInfo.apiVersion, extensionCount, createInfo.enabledLayerCount, NULL);
 }
 
 void setupDebugMessenger(AppState* pState) {
-    if (!pState->enableValidationLayers)
+    if (!pState->options.enableValidationLayers)
         return;
 
     VkDebugUtilsMessengerCreateInfoEXT createInfo;
@@ -200,13 +587,15 @@ void setupDebugMessenger(AppState* pState) {
     if (CreateDebugUtilsMessengerEXT(pState->instance, &createInfo, NULL, &pState->debugMessenger) != VK_SUCCESS) {
         printf( "%s - failed to set up debug messenger!\n", __FUNCTION__ );
     }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_DEBUG_MESSENGER, createInfo.messageSeverity, createInfo.messageType, 0, NULL);
 }
 
 bool createSurface(AppState* pState) {
-    if (glfwCreateWindowSurface(pState->instance, pState->pWindow, NULL, &pState->surface) != VK_SUCCESS) {
+    if (glfwCreateWindowSurface(pState->instance, pState->run.pWindow, NULL, &pState->surface) != VK_SUCCESS) {
         printf( "%s - failed to create window surface!\n", __FUNCTION__ );
         return false;
     }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_SURFACE, 0, 0, 0, NULL);
 
     return true;
 }
@@ -226,11 +615,15 @@ bool findQueueFamilies(AppState* pState) {
     for (int i = 0; i < queueFamilyCount; ++i) {
         VkBool32 graphicsSupport = queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT;
 
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(pState->physicalDevice, i, pState->surface, &presentSupport);
+        VkBool32 presentSupport = pState->options.headless;
+        if (!pState->options.headless) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(pState->physicalDevice, i, pState->surface, &presentSupport);
+        }
 
         if (graphicsSupport && presentSupport) {
             pState->graphicsQueueFamilyIndex = i;
+            pState->timestampValidBits = queueFamilies[i].timestampValidBits;
+            pState->queueFlags = queueFamilies[i].queueFlags;
             return true;
         }
     }
@@ -253,6 +646,38 @@ void pickPhysicalDevice(AppState* pState) {
     // Todo Implement Query OpenVR for the physical device to use
     // If no OVR fallback to first one. OVR Vulkan used this logic, its much simpler than vulkan example, is it correct? Seemed to be on my 6950xt
     pState->physicalDevice = devices[0];
+
+    // Reference runs want the same software rasteriser (lavapipe) on every machine, whatever GPU is installed.
+    if (pState->options.headless) {
+        for (uint32_t i = 0; i < deviceCount; ++i) {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(devices[i], &properties);
+            if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU) {
+                pState->physicalDevice = devices[i];
+                break;
+            }
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(pState->physicalDevice, &properties);
+        printf( "%s - headless on %s\n", __FUNCTION__, properties.deviceName);
+    }
+}
+
+bool isDeviceExtensionSupported(AppState* pState, const char* extensionName) {
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(pState->physicalDevice, NULL, &extensionCount, NULL);
+
+    VkExtensionProperties availableExtensions[extensionCount];
+    vkEnumerateDeviceExtensionProperties(pState->physicalDevice, NULL, &extensionCount, availableExtensions);
+
+    for (int i = 0; i < extensionCount; ++i) {
+        if (strcmp(extensionName, availableExtensions[i].extensionName) == 0) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 bool createLogicalDevice(AppState* pState) {
@@ -275,18 +700,102 @@ bool createLogicalDevice(AppState* pState) {
         queueCreateInfos[i] = queueCreateInfo;
     }
 
-    VkPhysicalDeviceFeatures deviceFeatures = {};
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(pState->physicalDevice, &supportedFeatures);
+
+    // Pipeline statistics let us measure overdraw and fragment invocations, but they are optional on some mobile parts.
+    pState->pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery;
+    if (!pState->pipelineStatisticsSupported) {
+        printf( "%s - pipelineStatisticsQuery not supported, overdraw statistics disabled.\n", __FUNCTION__ );
+    }
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(pState->physicalDevice, &deviceProperties);
+    pState->timestampPeriod = deviceProperties.limits.timestampPeriod;
+    pState->multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect;
+    pState->maxDrawIndirectCount = supportedFeatures.multiDrawIndirect ? deviceProperties.limits.maxDrawIndirectCount : 1;
+
+    // Texture streaming writes feedback from the fragment shader, and binds pages sparsely when the queue can.
+    if (pState->options.enableVirtualTexture) {
+        pState->fragmentStoresSupported = supportedFeatures.fragmentStoresAndAtomics;
+        pState->sparseResidencySupported = supportedFeatures.sparseBinding && supportedFeatures.sparseResidencyImage2D &&
+                                           (pState->queueFlags & VK_QUEUE_SPARSE_BINDING_BIT);
+    }
+
+    // Timeline semaphores are core and mandatory from 1.2. Mesh shading needs the extension plus both task and mesh
+    // stages. Both are queried through features2.
+    const bool features2Supported = deviceProperties.apiVersion >= VK_API_VERSION_1_2;
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+    };
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+    };
+    if (features2Supported) {
+        if (pState->options.enableMeshShader && isDeviceExtensionSupported(pState, VK_EXT_MESH_SHADER_EXTENSION_NAME)) {
+            timelineSemaphoreFeatures.pNext = &meshShaderFeatures;
+        }
+
+        VkPhysicalDeviceFeatures2 supportedFeatures2 = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                .pNext = &timelineSemaphoreFeatures,
+        };
+        vkGetPhysicalDeviceFeatures2(pState->physicalDevice, &supportedFeatures2);
+    }
+    pState->meshShaderSupported = meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+    pState->timelineSemaphoreSupported = pState->options.enableTimelineSemaphore && timelineSemaphoreFeatures.timelineSemaphore;
+    if (!pState->timelineSemaphoreSupported) {
+        printf( "%s - timeline semaphores not used, queue timelines fall back to fences.\n", __FUNCTION__ );
+    }
+
+    VkPhysicalDeviceFeatures deviceFeatures = {
+            .multiDrawIndirect = pState->multiDrawIndirectSupported,
+            .pipelineStatisticsQuery = pState->pipelineStatisticsSupported,
+            .fragmentStoresAndAtomics = pState->fragmentStoresSupported,
+            .sparseBinding = pState->sparseResidencySupported,
+            .sparseResidencyImage2D = pState->sparseResidencySupported,
+    };
+
+    const char* enabledExtensions[requiredExtensionCount + 1];
+    uint32_t enabledExtensionCount = 0;
+    for (int i = 0; i < requiredExtensionCount && !pState->options.headless; ++i) {
+        enabledExtensions[enabledExtensionCount++] = requiredExtensions[i];
+    }
 
     VkDeviceCreateInfo createInfo = {
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
             .queueCreateInfoCount = queueFamilyCount,
             .pQueueCreateInfos = queueCreateInfos,
             .pEnabledFeatures = &deviceFeatures,
-            .enabledExtensionCount = requiredExtensionCount,
-            .ppEnabledExtensionNames = requiredExtensions,
     };
 
-    if (pState->enableValidationLayers) {
+    VkPhysicalDeviceMeshShaderFeaturesEXT enabledMeshShaderFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+            .taskShader = VK_TRUE,
+            .meshShader = VK_TRUE,
+    };
+    VkPhysicalDeviceTimelineSemaphoreFeatures enabledTimelineSemaphoreFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+            .pNext = pState->meshShaderSupported ? &enabledMeshShaderFeatures : NULL,
+            .timelineSemaphore = pState->timelineSemaphoreSupported,
+    };
+    VkPhysicalDeviceFeatures2 enabledFeatures2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &enabledTimelineSemaphoreFeatures,
+            .features = deviceFeatures,
+    };
+    if (features2Supported) {
+        createInfo.pNext = &enabledFeatures2;
+        createInfo.pEnabledFeatures = NULL;
+    }
+    if (pState->meshShaderSupported) {
+        enabledExtensions[enabledExtensionCount++] = VK_EXT_MESH_SHADER_EXTENSION_NAME;
+    }
+
+    createInfo.enabledExtensionCount = enabledExtensionCount;
+    createInfo.ppEnabledExtensionNames = enabledExtensions;
+
+    if (pState->options.enableValidationLayers) {
         createInfo.enabledLayerCount = validationLayersCount;
         createInfo.ppEnabledLayerNames = validationLayers;
     } else {
@@ -297,6 +806,9 @@ bool createLogicalDevice(AppState* pState) {
         printf( "%s - failed to create logical device!\n", __FUNCTION__ );
         return false;
     }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_DEVICE, enabledExtensionCount, pState->meshShaderSupported, pState->timelineSemaphoreSupported, NULL);
+
+    loadDeviceFunctions(pState->device);
 
     vkGetDeviceQueue(pState->device, pState->graphicsQueueFamilyIndex, 0, &pState->queue);
 
@@ -355,8 +867,8 @@ VkExtent2D chooseSwapExtent(AppState* pState, const VkSurfaceCapabilitiesKHR cap
     if ( capabilities.currentExtent.width == -1 )
     {
         // If the surface size is undefined, the size is set to the size of the images requested.
-        extents.width = pState->screenWidth;
-        extents.height = pState->screenHeight;
+        extents.width = pState->options.screenWidth;
+        extents.height = pState->options.screenHeight;
     }
     else
     {
@@ -416,6 +928,10 @@ void createSwapChain(AppState* pState) {
     else
     {
         printf( "Vulkan swapchain does not support VK_IMAGE_USAGE_TRANSFER_DST_BIT. Some operations may not be supported.\n" );
+        if (pState->options.enableDynamicResolution) {
+            printf("%s - dynamic resolution needs to blit into the swapchain, disabling it!\n", __FUNCTION__);
+            pState->options.enableDynamicResolution = false;
+        }
     }
 
     VkSwapchainCreateInfoKHR createInfo = {
@@ -432,7 +948,8 @@ void createSwapChain(AppState* pState) {
             .queueFamilyIndexCount = 0,
             .pQueueFamilyIndices = NULL,
             .presentMode = presentMode,
-            .clipped = VK_TRUE
+            // Idle mode presents images again without rendering them, so obscured pixels have to keep their contents.
+            .clipped = pState->options.enableIdle ? VK_FALSE : VK_TRUE
     };
     if ( ( capabilities.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR ) != 0 )
     {
@@ -450,11 +967,15 @@ void createSwapChain(AppState* pState) {
     if (vkCreateSwapchainKHR(pState->device, &createInfo, NULL, &pState->swapChain) != VK_SUCCESS) {
         printf( "%s - failed to create swap chain!\n", __FUNCTION__ );
     }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_SWAPCHAIN, extent.width, extent.height, surfaceFormat.format, NULL);
 
     vkGetSwapchainImagesKHR(pState->device, pState->swapChain, &pState->swapChainImageCount, NULL);
     pState->pSwapChainImages =  malloc(sizeof(VkImage) * pState->swapChainImageCount);
     vkGetSwapchainImagesKHR(pState->device, pState->swapChain, &pState->swapChainImageCount, pState->pSwapChainImages);
 
+    pState->pSwapChainImageGenerations = malloc(sizeof(uint64_t) * pState->swapChainImageCount);
+    memset(pState->pSwapChainImageGenerations, 0xFF, sizeof(uint64_t) * pState->swapChainImageCount);
+
     pState->swapChainImageFormat = surfaceFormat.format;
     pState->swapChainExtent = extent;
 }
@@ -482,7 +1003,142 @@ void createImageViews(AppState* pState) {
         if (vkCreateImageView(pState->device, &createInfo, NULL, &pState->pSwapChainImageViews[i]) != VK_SUCCESS) {
             printf( "%s - failed to create image views!\n", __FUNCTION__ );
         }
+        recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_IMAGE_VIEW, pState->swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1, NULL);
+    }
+}
+
+VkImageView createImageView(AppState* pState, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
+    VkImageViewCreateInfo createInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = format,
+            .subresourceRange.aspectMask = aspectFlags,
+            .subresourceRange.baseMipLevel = 0,
+            .subresourceRange.levelCount = mipLevels,
+            .subresourceRange.baseArrayLayer = 0,
+            .subresourceRange.layerCount = 1,
+    };
+
+    VkImageView imageView;
+    if (vkCreateImageView(pState->device, &createInfo, NULL, &imageView) != VK_SUCCESS) {
+        printf( "%s - failed to create image view!\n", __FUNCTION__ );
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_IMAGE_VIEW, format, aspectFlags, mipLevels, NULL);
+
+    return imageView;
+}
+
+uint32_t findMemoryType(AppState* pState, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(pState->physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    printf( "%s - failed to find suitable memory type!\n", __FUNCTION__ );
+    return 0;
+}
+
+void createImage(AppState* pState, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage* pImage, VkDeviceMemory* pImageMemory) {
+    VkImageCreateInfo imageInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .extent.width = width,
+            .extent.height = height,
+            .extent.depth = 1,
+            .mipLevels = mipLevels,
+            .arrayLayers = 1,
+            .format = format,
+            .tiling = tiling,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .usage = usage,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    if (vkCreateImage(pState->device, &imageInfo, NULL, pImage) != VK_SUCCESS) {
+        printf( "%s - failed to create image!\n", __FUNCTION__ );
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_IMAGE, (uint64_t) width << 32 | height, (uint64_t) format << 32 | mipLevels, usage, NULL);
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(pState->device, *pImage, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = memRequirements.size,
+            .memoryTypeIndex = findMemoryType(pState, memRequirements.memoryTypeBits, properties),
+    };
+
+    if (vkAllocateMemory(pState->device, &allocInfo, NULL, pImageMemory) != VK_SUCCESS) {
+        printf( "%s - failed to allocate image memory!\n", __FUNCTION__ );
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_MEMORY, allocInfo.allocationSize, allocInfo.memoryTypeIndex, properties, NULL);
+
+    vkBindImageMemory(pState->device, *pImage, *pImageMemory, 0);
+}
+
+VkFormat findSupportedFormat(AppState* pState, const VkFormat* candidates, uint32_t candidateCount, VkImageTiling tiling, VkFormatFeatureFlags features) {
+    for (int i = 0; i < candidateCount; ++i) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(pState->physicalDevice, candidates[i], &props);
+
+        if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
+            return candidates[i];
+        } else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+            return candidates[i];
+        }
+    }
+
+    printf( "%s - failed to find supported format!\n", __FUNCTION__ );
+    return VK_FORMAT_UNDEFINED;
+}
+
+void createDepthResources(AppState* pState) {
+    // In order of preference: we never read stencil, so the pure depth formats come first. D16 is always supported.
+    const VkFormat candidates[] = {
+            VK_FORMAT_D32_SFLOAT,
+            VK_FORMAT_X8_D24_UNORM_PACK32,
+            VK_FORMAT_D24_UNORM_S8_UINT,
+            VK_FORMAT_D16_UNORM,
+    };
+    pState->depthFormat = findSupportedFormat(pState, candidates, sizeof(candidates) / sizeof(candidates[0]), VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+    // Depth is never stored, so on tilers it can stay entirely in tile memory.
+    createImage(pState, pState->swapChainExtent.width, pState->swapChainExtent.height, 1, pState->depthFormat, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pState->depthImage, &pState->depthImageMemory);
+    pState->depthImageView = createImageView(pState, pState->depthImage, pState->depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+}
+
+// Colour target for dynamic resolution, in the swapchain format so the upscale is a plain blit. It is allocated at
+// the full swapchain extent once and each frame renders into its top left corner, so changing the resolution never
+// reallocates anything.
+void createOffscreenTarget(AppState* pState) {
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(pState->physicalDevice, pState->swapChainImageFormat, &formatProperties);
+    const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                                  VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures) {
+        printf("%s - swapchain format can't be blitted with linear filtering, disabling dynamic resolution!\n", __FUNCTION__);
+        pState->options.enableDynamicResolution = false;
+        return;
     }
+
+    createImage(pState, pState->swapChainExtent.width, pState->swapChainExtent.height, 1, pState->swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &pState->offscreenImage, &pState->offscreenImageMemory);
+    pState->offscreenImageView = createImageView(pState, pState->offscreenImage, pState->swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
+void destroyOffscreenTarget(AppState* pState) {
+    vkDestroyFramebuffer(pState->device, pState->offscreenFramebuffer, NULL);
+    vkDestroyImageView(pState->device, pState->offscreenImageView, NULL);
+    vkDestroyImage(pState->device, pState->offscreenImage, NULL);
+    vkFreeMemory(pState->device, pState->offscreenImageMemory, NULL);
 }
 
 void createRenderPass(AppState* pState) {
@@ -494,7 +1150,18 @@ void createRenderPass(AppState* pState) {
             .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
             .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            .finalLayout = pState->options.headless || pState->options.enableDynamicResolution ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    };
+
+    VkAttachmentDescription depthAttachment = {
+            .format = pState->depthFormat,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
     };
 
     VkAttachmentReference colorAttachmentRef = {
@@ -502,35 +1169,56 @@ void createRenderPass(AppState* pState) {
             .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
     };
 
+    VkAttachmentReference depthAttachmentRef = {
+            .attachment = 1,
+            .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    };
+
     VkSubpassDescription subpass = {
             .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
             .colorAttachmentCount = 1,
             .pColorAttachments = &colorAttachmentRef,
+            .pDepthStencilAttachment = &depthAttachmentRef,
     };
 
     // OVR example doesn't have this
     VkSubpassDependency dependency = {
             .srcSubpass = VK_SUBPASS_EXTERNAL,
             .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    };
+
+    // Headless and dynamic resolution frames are copied out right after the pass, so the colour writes and final
+    // layout transition have to land before the transfer.
+    VkSubpassDependency readbackDependency = {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
             .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .srcAccessMask = 0,
-            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
     };
+    VkSubpassDependency dependencies[] = {dependency, readbackDependency};
+
+    VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment};
 
     VkRenderPassCreateInfo renderPassInfo = {
             .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-            .attachmentCount = 1,
-            .pAttachments = &colorAttachment,
+            .attachmentCount = 2,
+            .pAttachments = attachments,
             .subpassCount = 1,
             .pSubpasses = &subpass,
-            .dependencyCount = 1,
-            .pDependencies = &dependency,
+            .dependencyCount = pState->options.headless || pState->options.enableDynamicResolution ? 2 : 1,
+            .pDependencies = dependencies,
     };
 
     if (vkCreateRenderPass(pState->device, &renderPassInfo, NULL, &pState->renderPass) != VK_SUCCESS) {
         printf("%s - failed to create render pass!\n", __FUNCTION__);
     }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_RENDER_PASS, pState->swapChainImageFormat, pState->depthFormat, renderPassInfo.dependencyCount, NULL);
 }
 
 static char* readBinaryFile(const char* filename, uint32_t *length) {
@@ -538,6 +1226,7 @@ static char* readBinaryFile(const char* filename, uint32_t *length) {
 
     if (file == NULL) {
         printf("%s - file can't be opened! %s\n", __FUNCTION__, filename);
+        return NULL;
     }
 
     fseek(file, 0, SEEK_END);
@@ -564,36 +1253,114 @@ VkShaderModule createShaderModule(AppState* pState, const char* code, const uint
     if (vkCreateShaderModule(pState->device, &createInfo, NULL, &shaderModule) != VK_SUCCESS) {
         printf("%s - failed to create shader module! %s\n", __FUNCTION__, code);
     }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_SHADER_MODULE, codeLength, 0, 0, NULL);
 
     return shaderModule;
 }
 
-void createGraphicsPipeline(AppState* pState) {
-    uint32_t vertLength;
-    const char* vertShaderCode = readBinaryFile("./shaders/vert.spv", &vertLength);
-    uint32_t fragLength;
-    const char* fragShaderCode = readBinaryFile("./shaders/frag.spv", &fragLength);
-
-    VkShaderModule vertShaderModule = createShaderModule(pState, vertShaderCode, vertLength);
-    VkShaderModule fragShaderModule = createShaderModule(pState, fragShaderCode, fragLength);
+// Seeds the cache from the copy kept in memory by the last savePipelineCache, which is what makes rebuilding the
+// pipelines after a device loss cheap, or else from the file an earlier run left. The driver ignores data it did not
+// write, so a cache from another GPU or driver version just starts empty.
+void createPipelineCache(AppState* pState) {
+    size_t dataSize = pState->run.pipelineCacheDataSize;
+    void* pData = pState->run.pPipelineCacheData;
+
+    if (pData == NULL) {
+        FILE* file = fopen(PIPELINE_CACHE_FILENAME, "rb");
+        if (file != NULL) {
+            fseek(file, 0, SEEK_END);
+            dataSize = ftell(file);
+            rewind(file);
+            pData = malloc(dataSize);
+            if (fread(pData, 1, dataSize, file) != dataSize) {
+                dataSize = 0;
+            }
+            fclose(file);
+        }
+    }
 
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .module = vertShaderModule,
-            .pName = "main",
+    VkPipelineCacheCreateInfo cacheInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .initialDataSize = dataSize,
+            .pInitialData = pData,
     };
 
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module = fragShaderModule,
-            .pName = "main",
-    };
+    if (vkCreatePipelineCache(pState->device, &cacheInfo, NULL, &pState->pipelineCache) != VK_SUCCESS) {
+        printf("%s - failed to create pipeline cache!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_PIPELINE_CACHE, 0, 0, 0, NULL);
+
+    if (pData != pState->run.pPipelineCacheData) {
+        free(pData);
+    }
+}
+
+// Keeps the cache contents in memory for a rebuild and writes them out for the next run.
+void savePipelineCache(AppState* pState) {
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(pState->device, pState->pipelineCache, &dataSize, NULL) != VK_SUCCESS || dataSize == 0) {
+        return;
+    }
 
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+    free(pState->run.pPipelineCacheData);
+    pState->run.pPipelineCacheData = malloc(dataSize);
+    if (vkGetPipelineCacheData(pState->device, pState->pipelineCache, &dataSize, pState->run.pPipelineCacheData) != VK_SUCCESS) {
+        printf("%s - failed to read pipeline cache!\n", __FUNCTION__);
+        free(pState->run.pPipelineCacheData);
+        pState->run.pPipelineCacheData = NULL;
+        pState->run.pipelineCacheDataSize = 0;
+        return;
+    }
+    pState->run.pipelineCacheDataSize = dataSize;
 
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+    FILE* file = fopen(PIPELINE_CACHE_FILENAME, "wb");
+    if (file == NULL) {
+        printf("%s - file can't be opened! %s\n", __FUNCTION__, PIPELINE_CACHE_FILENAME);
+        return;
+    }
+    fwrite(pState->run.pPipelineCacheData, 1, dataSize, file);
+    fclose(file);
+}
+
+typedef struct PipelineShaderDesc {
+    VkShaderStageFlagBits stage;
+    const char* filename;
+} PipelineShaderDesc;
+
+// Everything that differs between the graphics pipelines we build, the rest of the fixed function state is shared.
+typedef struct GraphicsPipelineDesc {
+    uint32_t shaderCount;
+    PipelineShaderDesc shaders[3];
+    const VkPipelineVertexInputStateCreateInfo* pVertexInputState;
+    VkPipelineLayout layout;
+    VkRenderPass renderPass;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    VkBool32 depthWriteEnable;
+    VkCompareOp depthCompareOp;
+    VkColorComponentFlags colorWriteMask;
+} GraphicsPipelineDesc;
+
+VkPipeline createGraphicsPipelineFromDesc(AppState* pState, const GraphicsPipelineDesc* pDesc) {
+    VkShaderModule shaderModules[3];
+    VkPipelineShaderStageCreateInfo shaderStages[3];
+
+    for (uint32_t i = 0; i < pDesc->shaderCount; ++i) {
+        uint32_t codeLength;
+        char* shaderCode = readBinaryFile(pDesc->shaders[i].filename, &codeLength);
+        shaderModules[i] = createShaderModule(pState, shaderCode, codeLength);
+        free(shaderCode);
+
+        VkPipelineShaderStageCreateInfo shaderStageInfo = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = pDesc->shaders[i].stage,
+                .module = shaderModules[i],
+                .pName = "main",
+        };
+        shaderStages[i] = shaderStageInfo;
+    }
+
+    VkPipelineVertexInputStateCreateInfo emptyVertexInputInfo = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
             .vertexBindingDescriptionCount = 0,
             .vertexAttributeDescriptionCount = 0,
@@ -617,8 +1384,8 @@ void createGraphicsPipeline(AppState* pState) {
             .rasterizerDiscardEnable = VK_FALSE,
             .polygonMode = VK_POLYGON_MODE_FILL,
             .lineWidth = 1.0f,
-            .cullMode = VK_CULL_MODE_BACK_BIT,
-            .frontFace = VK_FRONT_FACE_CLOCKWISE,
+            .cullMode = pDesc->cullMode,
+            .frontFace = pDesc->frontFace,
             .depthBiasEnable = VK_FALSE,
     };
 
@@ -628,8 +1395,17 @@ void createGraphicsPipeline(AppState* pState) {
             .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
     };
 
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+            .depthTestEnable = VK_TRUE,
+            .depthWriteEnable = pDesc->depthWriteEnable,
+            .depthCompareOp = pDesc->depthCompareOp,
+            .depthBoundsTestEnable = VK_FALSE,
+            .stencilTestEnable = VK_FALSE,
+    };
+
     VkPipelineColorBlendAttachmentState colorBlendAttachment = {
-            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+            .colorWriteMask = pDesc->colorWriteMask,
             .blendEnable = VK_FALSE,
     };
 
@@ -656,39 +1432,78 @@ void createGraphicsPipeline(AppState* pState) {
             .pDynamicStates = dynamicStates,
     };
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount = 0,
-        .pushConstantRangeCount = 0,
-    };
-
-    if (vkCreatePipelineLayout(pState->device, &pipelineLayoutInfo, NULL, &pState->pipelineLayout) != VK_SUCCESS) {
-        printf("%s - failed to create pipeline layout!\n", __FUNCTION__);
-    }
+    // Mesh shading pipelines fetch their own geometry so they have no vertex input or input assembly state.
+    bool meshShading = pDesc->shaders[0].stage == VK_SHADER_STAGE_TASK_BIT_EXT || pDesc->shaders[0].stage == VK_SHADER_STAGE_MESH_BIT_EXT;
 
     VkGraphicsPipelineCreateInfo pipelineInfo = {
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-            .stageCount = 2,
+            .stageCount = pDesc->shaderCount,
             .pStages = shaderStages,
-            .pVertexInputState = &vertexInputInfo,
-            .pInputAssemblyState = &inputAssembly,
+            .pVertexInputState = meshShading ? NULL : pDesc->pVertexInputState != NULL ? pDesc->pVertexInputState : &emptyVertexInputInfo,
+            .pInputAssemblyState = meshShading ? NULL : &inputAssembly,
             .pViewportState = &viewportState,
             .pRasterizationState = &rasterizer,
             .pMultisampleState = &multisampling,
+            .pDepthStencilState = &depthStencil,
             .pColorBlendState = &colorBlending,
             .pDynamicState = &dynamicState,
-            .layout = pState->pipelineLayout,
-            .renderPass = pState->renderPass,
+            .layout = pDesc->layout,
+            .renderPass = pDesc->renderPass,
             .subpass = 0,
             .basePipelineHandle = VK_NULL_HANDLE,
     };
 
-    if (vkCreateGraphicsPipelines(pState->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &pState->graphicsPipeline) != VK_SUCCESS) {
-        printf("%s - failed to create graphics pipeline!\n", __FUNCTION__);
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(pState->device, pState->pipelineCache, 1, &pipelineInfo, NULL, &pipeline) != VK_SUCCESS) {
+        printf("%s - failed to create graphics pipeline! %s\n", __FUNCTION__, pDesc->shaders[0].filename);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_PIPELINE, VK_PIPELINE_BIND_POINT_GRAPHICS, pDesc->shaderCount, (uint64_t) pDesc->cullMode << 32 | pDesc->depthCompareOp, pDesc->shaders[0].filename);
+
+    for (uint32_t i = 0; i < pDesc->shaderCount; ++i) {
+        vkDestroyShaderModule(pState->device, shaderModules[i], NULL);
     }
 
-    vkDestroyShaderModule(pState->device, fragShaderModule, NULL);
-    vkDestroyShaderModule(pState->device, vertShaderModule, NULL);
+    return pipeline;
+}
+
+void createGraphicsPipeline(AppState* pState) {
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 0,
+        .pushConstantRangeCount = 0,
+    };
+
+    if (vkCreatePipelineLayout(pState->device, &pipelineLayoutInfo, NULL, &pState->pipelineLayout) != VK_SUCCESS) {
+        printf("%s - failed to create pipeline layout!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_PIPELINE_LAYOUT, pipelineLayoutInfo.setLayoutCount, pipelineLayoutInfo.pushConstantRangeCount, 0, NULL);
+
+    // With a depth pre-pass the depth buffer already holds the nearest surface, so shading only tests against it and
+    // every hidden fragment is rejected by early-Z before the fragment shader runs.
+    GraphicsPipelineDesc pipelineDesc = {
+            .shaderCount = 2,
+            .shaders = {
+                    {VK_SHADER_STAGE_VERTEX_BIT, "./shaders/vert.spv"},
+                    {VK_SHADER_STAGE_FRAGMENT_BIT, "./shaders/frag.spv"},
+            },
+            .layout = pState->pipelineLayout,
+            .renderPass = pState->renderPass,
+            .cullMode = VK_CULL_MODE_BACK_BIT,
+            .frontFace = VK_FRONT_FACE_CLOCKWISE,
+            .depthWriteEnable = pState->options.enableDepthPrePass ? VK_FALSE : VK_TRUE,
+            .depthCompareOp = pState->options.enableDepthPrePass ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_LESS,
+            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+    pState->graphicsPipeline = createGraphicsPipelineFromDesc(pState, &pipelineDesc);
+
+    if (pState->options.enableDepthPrePass) {
+        // Depth only, so no fragment stage and no colour writes.
+        pipelineDesc.shaderCount = 1;
+        pipelineDesc.depthWriteEnable = VK_TRUE;
+        pipelineDesc.depthCompareOp = VK_COMPARE_OP_LESS;
+        pipelineDesc.colorWriteMask = 0;
+        pState->depthPrePassPipeline = createGraphicsPipelineFromDesc(pState, &pipelineDesc);
+    }
 }
 
 void createFramebuffers(AppState* pState) {
@@ -696,13 +1511,14 @@ void createFramebuffers(AppState* pState) {
 
     for (size_t i = 0; i < pState->swapChainImageCount; i++) {
         VkImageView attachments[] = {
-                pState->pSwapChainImageViews[i]
+                pState->pSwapChainImageViews[i],
+                pState->depthImageView
         };
 
         VkFramebufferCreateInfo framebufferInfo = {
                 .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
                 .renderPass = pState->renderPass,
-                .attachmentCount = 1,
+                .attachmentCount = 2,
                 .pAttachments = attachments,
                 .width = pState->swapChainExtent.width,
                 .height = pState->swapChainExtent.height,
@@ -712,6 +1528,29 @@ void createFramebuffers(AppState* pState) {
         if (vkCreateFramebuffer(pState->device, &framebufferInfo, NULL, &pState->pSwapChainFramebuffers[i]) != VK_SUCCESS) {
             printf("%s - failed to create framebuffer!\n", __FUNCTION__);
         }
+        recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_FRAMEBUFFER, framebufferInfo.width, framebufferInfo.height, framebufferInfo.attachmentCount, NULL);
+    }
+
+    if (pState->options.enableDynamicResolution) {
+        VkImageView attachments[] = {
+                pState->offscreenImageView,
+                pState->depthImageView
+        };
+
+        VkFramebufferCreateInfo framebufferInfo = {
+                .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+                .renderPass = pState->renderPass,
+                .attachmentCount = 2,
+                .pAttachments = attachments,
+                .width = pState->swapChainExtent.width,
+                .height = pState->swapChainExtent.height,
+                .layers = 1,
+        };
+
+        if (vkCreateFramebuffer(pState->device, &framebufferInfo, NULL, &pState->offscreenFramebuffer) != VK_SUCCESS) {
+            printf("%s - failed to create offscreen framebuffer!\n", __FUNCTION__);
+        }
+        recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_FRAMEBUFFER, framebufferInfo.width, framebufferInfo.height, framebufferInfo.attachmentCount, NULL);
     }
 }
 
@@ -725,6 +1564,7 @@ void createCommandPool(AppState* pState) {
     if (vkCreateCommandPool(pState->device, &poolInfo, NULL, &pState->commandPool) != VK_SUCCESS) {
         printf("%s - failed to create command pool!\n", __FUNCTION__);
     }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_COMMAND_POOL, poolInfo.queueFamilyIndex, poolInfo.flags, 0, NULL);
 }
 
 void createCommandBuffer(AppState* pState) {
@@ -738,156 +1578,2652 @@ void createCommandBuffer(AppState* pState) {
     if (vkAllocateCommandBuffers(pState->device, &allocInfo, &pState->commandBuffer) != VK_SUCCESS) {
         printf("%s - failed to allocate command buffers!\n", __FUNCTION__);
     }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_COMMAND_BUFFER, allocInfo.level, allocInfo.commandBufferCount, 0, NULL);
 }
 
-void createSyncObjects(AppState* pState) {
-    VkSemaphoreCreateInfo semaphoreInfo = {
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
-    };
+void createQueueTimeline(AppState* pState, QueueTimeline* pTimeline, VkQueue queue) {
+    memset(pTimeline, 0, sizeof(*pTimeline));
+    pTimeline->queue = queue;
+
+    if (pState->timelineSemaphoreSupported) {
+        VkSemaphoreTypeCreateInfo typeInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+                .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+                .initialValue = 0,
+        };
+        VkSemaphoreCreateInfo semaphoreInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+                .pNext = &typeInfo,
+        };
+
+        if (vkCreateSemaphore(pState->device, &semaphoreInfo, NULL, &pTimeline->semaphore) != VK_SUCCESS) {
+            printf("%s - failed to create timeline semaphore!\n", __FUNCTION__);
+        }
+        recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_SEMAPHORE, VK_SEMAPHORE_TYPE_TIMELINE, 0, 0, NULL);
+        return;
+    }
 
     VkFenceCreateInfo fenceInfo = {
             .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-            .flags = VK_FENCE_CREATE_SIGNALED_BIT,
     };
-
-    if (vkCreateSemaphore(pState->device, &semaphoreInfo, NULL, &pState->imageAvailableSemaphore) != VK_SUCCESS ||
-        vkCreateSemaphore(pState->device, &semaphoreInfo, NULL, &pState->renderFinishedSemaphore) != VK_SUCCESS ||
-        vkCreateFence(pState->device, &fenceInfo, NULL, &pState->inFlightFence) != VK_SUCCESS) {
-        printf("%s - failed to create synchronization objects for a frame!\n", __FUNCTION__);
+    for (int i = 0; i < TIMELINE_FENCE_RING_SIZE; ++i) {
+        if (vkCreateFence(pState->device, &fenceInfo, NULL, &pTimeline->fences[i]) != VK_SUCCESS) {
+            printf("%s - failed to create timeline fence!\n", __FUNCTION__);
+        }
+        recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_FENCE, 0, 0, 0, NULL);
     }
 }
 
-void recordCommandBuffer(AppState* pState, uint32_t imageIndex) {
-    VkCommandBufferBeginInfo beginInfo = {
-            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO
-    };
+void destroyQueueTimeline(AppState* pState, QueueTimeline* pTimeline) {
+    vkDestroySemaphore(pState->device, pTimeline->semaphore, NULL);
+    for (int i = 0; i < TIMELINE_FENCE_RING_SIZE; ++i) {
+        vkDestroyFence(pState->device, pTimeline->fences[i], NULL);
+    }
+}
 
-    if (vkBeginCommandBuffer(pState->commandBuffer, &beginInfo) != VK_SUCCESS) {
-        printf("%s - failed to begin recording command buffer!\n", __FUNCTION__);
+// Device loss can surface from any call that touches the queue, on the frame thread or the submit thread. The first
+// one to see it flags the state; the frame loop then abandons the frame and rebuilds the device.
+void checkDeviceLost(AppState* pState, VkResult result, const char* pWhere) {
+    if (result == VK_ERROR_DEVICE_LOST && !atomic_exchange(&pState->deviceLost, true)) {
+        printf("%s - device lost in %s!\n", __FUNCTION__, pWhere);
     }
+}
 
-    VkRenderPassBeginInfo renderPassInfo = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .renderPass = pState->renderPass,
-            .framebuffer = pState->pSwapChainFramebuffers[imageIndex],
-            .renderArea.offset = {0, 0},
-            .renderArea.extent = pState->swapChainExtent,
-    };
+// Completion only ever moves forward, whichever thread's wait returns first.
+static void advanceCompletedValue(QueueTimeline* pTimeline, uint64_t value) {
+    uint64_t completed = atomic_load(&pTimeline->completedValue);
+    while (completed < value && !atomic_compare_exchange_weak(&pTimeline->completedValue, &completed, value)) {
+    }
+}
 
-    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+// Blocks until the queue has finished everything up to and including value.
+bool waitForTimeline(AppState* pState, QueueTimeline* pTimeline, uint64_t value) {
+    if (value <= pTimeline->completedValue) {
+        return true;
+    }
 
-    vkCmdBeginRenderPass(pState->commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if (value > pTimeline->lastSubmittedValue) {
+        printf("%s - waiting for value %llu that was never submitted!\n", __FUNCTION__, (unsigned long long) value);
+        return false;
+    }
 
-    vkCmdBindPipeline(pState->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pState->graphicsPipeline);
+    if (pState->timelineSemaphoreSupported) {
+        VkSemaphoreWaitInfo waitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                .semaphoreCount = 1,
+                .pSemaphores = &pTimeline->semaphore,
+                .pValues = &value,
+        };
+        VkResult result = vkWaitSemaphores(pState->device, &waitInfo, UINT64_MAX);
+        if (result != VK_SUCCESS) {
+            checkDeviceLost(pState, result, __FUNCTION__);
+            printf("%s - failed to wait for timeline!\n", __FUNCTION__);
+            return false;
+        }
+    } else {
+        // Only the last batch of a submit call carries a fence. Fences signal in submission order, so waiting for
+        // the first one at or past value covers everything before it.
+        int fenceIndex = -1;
+        for (int i = 0; i < TIMELINE_FENCE_RING_SIZE; ++i) {
+            if (pTimeline->fenceValues[i] >= value && (fenceIndex < 0 || pTimeline->fenceValues[i] < pTimeline->fenceValues[fenceIndex])) {
+                fenceIndex = i;
+            }
+        }
+        if (fenceIndex < 0) {
+            printf("%s - no fence covers value %llu!\n", __FUNCTION__, (unsigned long long) value);
+            return false;
+        }
 
-    VkViewport viewport = {
-            .x = 0.0f,
-            .y = 0.0f,
-            .width = (float) pState->swapChainExtent.width,
-            .height = (float) pState->swapChainExtent.height,
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f,
-    };
-    vkCmdSetViewport(pState->commandBuffer, 0, 1, &viewport);
+        value = pTimeline->fenceValues[fenceIndex];
+        VkResult result = vkWaitForFences(pState->device, 1, &pTimeline->fences[fenceIndex], VK_TRUE, UINT64_MAX);
+        if (result != VK_SUCCESS) {
+            checkDeviceLost(pState, result, __FUNCTION__);
+            printf("%s - failed to wait for fence!\n", __FUNCTION__);
+            return false;
+        }
+        for (int i = 0; i < TIMELINE_FENCE_RING_SIZE; ++i) {
+            if (pTimeline->fenceValues[i] != 0 && pTimeline->fenceValues[i] <= value) {
+                pTimeline->fenceValues[i] = 0;
+            }
+        }
+    }
+
+    advanceCompletedValue(pTimeline, value);
+    return true;
+}
+
+typedef struct SubmitInfoStorage {
+    VkSemaphore waitSemaphores[TIMELINE_MAX_WAITS + 1];
+    uint64_t waitValues[TIMELINE_MAX_WAITS + 1];
+    VkPipelineStageFlags waitStages[TIMELINE_MAX_WAITS + 1];
+    VkSemaphore signalSemaphores[2];
+    uint64_t signalValues[2];
+    VkTimelineSemaphoreSubmitInfo timelineInfo;
+} SubmitInfoStorage;
+
+// Submits descCount batches in a single vkQueueSubmit. Each batch signals the timeline's next value in order, and
+// pSignalValues receives them. Waits on another queue's timeline become GPU side semaphore waits; in the fence
+// fallback they are resolved on the CPU before submitting instead.
+void submitBatchesToTimeline(AppState* pState, QueueTimeline* pTimeline, const QueueSubmitDesc* pDescs, uint32_t descCount,
+                             uint64_t* pSignalValues) {
+    if (descCount == 0) {
+        return;
+    }
+
+    SubmitInfoStorage storage[descCount];
+    VkSubmitInfo submitInfos[descCount];
+    const uint64_t firstValue = pTimeline->lastSubmittedValue + 1;
+
+    for (uint32_t d = 0; d < descCount; ++d) {
+        const QueueSubmitDesc* pDesc = &pDescs[d];
+        SubmitInfoStorage* pStorage = &storage[d];
+        uint32_t waitCount = 0;
+
+        if (pDesc->waitCount > TIMELINE_MAX_WAITS) {
+            printf("%s - batch %u has %u waits, only the first %d are honoured!\n", __FUNCTION__, d, pDesc->waitCount, TIMELINE_MAX_WAITS);
+        }
+
+        for (uint32_t i = 0; i < pDesc->waitCount && i < TIMELINE_MAX_WAITS; ++i) {
+            const TimelineWait* pWait = &pDesc->pWaits[i];
+            if (pWait->value <= pWait->pTimeline->completedValue) {
+                continue;
+            }
+
+            if (pState->timelineSemaphoreSupported) {
+                pStorage->waitSemaphores[waitCount] = pWait->pTimeline->semaphore;
+                pStorage->waitValues[waitCount] = pWait->value;
+                pStorage->waitStages[waitCount] = pWait->stageMask;
+                waitCount++;
+            } else if (pWait->pTimeline != pTimeline || pWait->value < firstValue) {
+                // Earlier submits on this timeline carry fences too, so they can be waited for like any other.
+                waitForTimeline(pState, pWait->pTimeline, pWait->value);
+            } else {
+                printf("%s - batch %u waits for value %llu of its own submit, which has no fence to wait on!\n", __FUNCTION__, d,
+                       (unsigned long long) pWait->value);
+            }
+        }
+
+        if (pDesc->binaryWaitSemaphore != VK_NULL_HANDLE) {
+            pStorage->waitSemaphores[waitCount] = pDesc->binaryWaitSemaphore;
+            pStorage->waitValues[waitCount] = 0;
+            pStorage->waitStages[waitCount] = pDesc->binaryWaitStageMask;
+            waitCount++;
+        }
+
+        uint32_t signalCount = 0;
+        if (pState->timelineSemaphoreSupported) {
+            pStorage->signalSemaphores[signalCount] = pTimeline->semaphore;
+            pStorage->signalValues[signalCount] = firstValue + d;
+            signalCount++;
+        }
+
+        if (pDesc->binarySignalSemaphore != VK_NULL_HANDLE) {
+            pStorage->signalSemaphores[signalCount] = pDesc->binarySignalSemaphore;
+            pStorage->signalValues[signalCount] = 0;
+            signalCount++;
+        }
+
+        pStorage->timelineInfo = (VkTimelineSemaphoreSubmitInfo) {
+                .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+                .waitSemaphoreValueCount = waitCount,
+                .pWaitSemaphoreValues = pStorage->waitValues,
+                .signalSemaphoreValueCount = signalCount,
+                .pSignalSemaphoreValues = pStorage->signalValues,
+        };
+
+        submitInfos[d] = (VkSubmitInfo) {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext = pState->timelineSemaphoreSupported ? &pStorage->timelineInfo : NULL,
+                .waitSemaphoreCount = waitCount,
+                .pWaitSemaphores = pStorage->waitSemaphores,
+                .pWaitDstStageMask = pStorage->waitStages,
+                .commandBufferCount = pDesc->commandBufferCount,
+                .pCommandBuffers = pDesc->pCommandBuffers,
+                .signalSemaphoreCount = signalCount,
+                .pSignalSemaphores = pStorage->signalSemaphores,
+        };
+
+        pSignalValues[d] = firstValue + d;
+    }
+
+    const uint64_t lastValue = firstValue + descCount - 1;
+
+    VkFence fence = VK_NULL_HANDLE;
+    if (!pState->timelineSemaphoreSupported) {
+        uint32_t slot = lastValue % TIMELINE_FENCE_RING_SIZE;
+        if (pTimeline->fenceValues[slot] != 0) {
+            waitForTimeline(pState, pTimeline, pTimeline->fenceValues[slot]);
+        }
+        vkResetFences(pState->device, 1, &pTimeline->fences[slot]);
+        pTimeline->fenceValues[slot] = lastValue;
+        fence = pTimeline->fences[slot];
+    }
+
+    VkResult result = vkQueueSubmit(pTimeline->queue, descCount, submitInfos, fence);
+    if (result != VK_SUCCESS) {
+        checkDeviceLost(pState, result, __FUNCTION__);
+        printf("%s - failed to submit to queue!\n", __FUNCTION__);
+    }
+
+    pTimeline->lastSubmittedValue = lastValue;
+}
+
+// Submits one batch that signals the timeline's next value and returns that value.
+uint64_t submitToTimeline(AppState* pState, QueueTimeline* pTimeline, const QueueSubmitDesc* pDesc) {
+    uint64_t signalValue;
+    submitBatchesToTimeline(pState, pTimeline, pDesc, 1, &signalValue);
+    return signalValue;
+}
+
+// Runs on whichever thread owns the queue: the submit thread, or the producer itself when there is none. Sparse
+// binds go first so the batches waiting on them can share the one submit call.
+static void flushSubmitBatches(AppState* pState, SubmitBatch** ppBatches, uint32_t batchCount) {
+    SubmitQueue* pSubmit = &pState->submitQueue;
+    QueueSubmitDesc descs[batchCount];
+    uint64_t signalValues[batchCount];
+
+    for (uint32_t i = 0; i < batchCount; ++i) {
+        const SubmitBatch* pBatch = ppBatches[i];
+        if (pBatch->pBindSparseInfo != NULL) {
+            VkResult result = vkQueueBindSparse(pState->queue, 1, pBatch->pBindSparseInfo, VK_NULL_HANDLE);
+            if (result != VK_SUCCESS) {
+                checkDeviceLost(pState, result, __FUNCTION__);
+                printf("%s - failed to bind sparse memory!\n", __FUNCTION__);
+            }
+        }
+        descs[i] = pBatch->desc;
+    }
+
+    submitBatchesToTimeline(pState, &pState->graphicsTimeline, descs, batchCount, signalValues);
+    atomic_fetch_add(&pSubmit->submitCallCount, 1);
+    atomic_fetch_add(&pSubmit->batchCount, batchCount);
+
+    for (uint32_t i = 0; i < batchCount; ++i) {
+        SubmitBatch* pBatch = ppBatches[i];
+        pBatch->timelineValue = signalValues[i];
+
+        if (pBatch->present) {
+            VkPresentInfoKHR presentInfo = {
+                    .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                    .waitSemaphoreCount = 1,
+                    .pWaitSemaphores = &pBatch->desc.binarySignalSemaphore,
+                    .swapchainCount = 1,
+                    .pSwapchains = &pState->swapChain,
+                    .pImageIndices = &pBatch->imageIndex,
+            };
+            pBatch->presentResult = vkQueuePresentKHR(pState->queue, &presentInfo);
+            checkDeviceLost(pState, pBatch->presentResult, __FUNCTION__);
+        }
+
+        atomic_store_explicit(&pBatch->pending, false, memory_order_release);
+    }
+
+    if (pSubmit->pDoneSemaphore != NULL) {
+        postPlatformSemaphore(pSubmit->pDoneSemaphore);
+    }
+}
+
+static void submitThreadMain(void* pArgument) {
+    AppState* pState = pArgument;
+    SubmitQueue* pSubmit = &pState->submitQueue;
+    SubmitBatch* pPending[SUBMIT_MAX_PENDING_BATCHES];
+    uint32_t pendingCount = 0;
+    double windowEnd = 0.0;
+
+    for (;;) {
+        double timeout = pendingCount > 0 ? windowEnd - getTimeSeconds() : SUBMIT_IDLE_WAKE_SECONDS;
+        if (timeout > 0.0) {
+            waitPlatformSemaphore(pSubmit->pWakeSemaphore, timeout);
+        }
+
+        bool stop = atomic_load(&pSubmit->stopRequested);
+        bool flush = atomic_exchange(&pSubmit->flushRequested, false) || stop;
+
+        MpscNode* pNode;
+        while ((pNode = popMpscQueue(&pSubmit->queue)) != NULL) {
+            if (pendingCount == SUBMIT_MAX_PENDING_BATCHES) {
+                flushSubmitBatches(pState, pPending, pendingCount);
+                pendingCount = 0;
+            }
+            if (pendingCount == 0) {
+                windowEnd = getTimeSeconds() + SUBMIT_FLUSH_WINDOW_SECONDS;
+            }
+
+            SubmitBatch* pBatch = (SubmitBatch*) pNode;
+            pPending[pendingCount++] = pBatch;
+            flush |= pBatch->present;
+        }
+
+        if (pendingCount > 0 && (flush || getTimeSeconds() >= windowEnd)) {
+            flushSubmitBatches(pState, pPending, pendingCount);
+            pendingCount = 0;
+        }
+
+        if (stop && pendingCount == 0) {
+            break;
+        }
+    }
+
+    pSubmit->threadCpuSeconds = getThreadCpuSeconds();
+}
+
+// From here on every queue submission and present has to go through enqueueSubmitBatch until stopSubmitThread.
+void startSubmitThread(AppState* pState) {
+    SubmitQueue* pSubmit = &pState->submitQueue;
+    if (!pState->options.enableSubmitThread || pSubmit->pThread != NULL) {
+        return;
+    }
+
+    // The fence fallback keeps its ring on the CPU, which is not safe to share between the submit thread and waiters.
+    if (!pState->timelineSemaphoreSupported) {
+        printf("%s - submit thread needs timeline semaphores, submitting inline!\n", __FUNCTION__);
+        return;
+    }
+
+    initMpscQueue(&pSubmit->queue);
+    atomic_store(&pSubmit->flushRequested, false);
+    atomic_store(&pSubmit->stopRequested, false);
+    pSubmit->pWakeSemaphore = createPlatformSemaphore();
+    pSubmit->pDoneSemaphore = createPlatformSemaphore();
+    pSubmit->pThread = startThread(submitThreadMain, pState);
+    if (pSubmit->pThread == NULL) {
+        destroyPlatformSemaphore(pSubmit->pWakeSemaphore);
+        destroyPlatformSemaphore(pSubmit->pDoneSemaphore);
+        pSubmit->pWakeSemaphore = NULL;
+        pSubmit->pDoneSemaphore = NULL;
+    }
+}
+
+// Flushes whatever is still queued and joins the thread, the queue is the caller's again afterwards.
+void stopSubmitThread(AppState* pState) {
+    SubmitQueue* pSubmit = &pState->submitQueue;
+    if (pSubmit->pThread == NULL) {
+        return;
+    }
+
+    atomic_store(&pSubmit->stopRequested, true);
+    postPlatformSemaphore(pSubmit->pWakeSemaphore);
+    joinThread(pSubmit->pThread);
+    pSubmit->pThread = NULL;
+
+    destroyPlatformSemaphore(pSubmit->pWakeSemaphore);
+    destroyPlatformSemaphore(pSubmit->pDoneSemaphore);
+    pSubmit->pWakeSemaphore = NULL;
+    pSubmit->pDoneSemaphore = NULL;
+}
+
+// Hands a batch to the submit thread, or submits it on the spot when there is none.
+void enqueueSubmitBatch(AppState* pState, SubmitBatch* pBatch) {
+    SubmitQueue* pSubmit = &pState->submitQueue;
+    atomic_store_explicit(&pBatch->pending, true, memory_order_relaxed);
+
+    if (pSubmit->pThread == NULL) {
+        flushSubmitBatches(pState, &pBatch, 1);
+        return;
+    }
+
+    pushMpscQueue(&pSubmit->queue, &pBatch->node);
+    postPlatformSemaphore(pSubmit->pWakeSemaphore);
+}
+
+// Waits for the batch to be submitted, and presented if it presents, then for the GPU to finish it. A batch that is
+// still queued closes the flush window early rather than waiting it out.
+void waitForSubmitBatch(AppState* pState, SubmitBatch* pBatch) {
+    SubmitQueue* pSubmit = &pState->submitQueue;
+
+    if (atomic_load_explicit(&pBatch->pending, memory_order_acquire)) {
+        atomic_store(&pSubmit->flushRequested, true);
+        postPlatformSemaphore(pSubmit->pWakeSemaphore);
+        // A post can belong to an earlier flush, so the flag is checked again after every wake.
+        while (atomic_load_explicit(&pBatch->pending, memory_order_acquire)) {
+            waitPlatformSemaphore(pSubmit->pDoneSemaphore, SUBMIT_IDLE_WAKE_SECONDS);
+        }
+    }
+
+    if (pBatch->timelineValue != 0) {
+        waitForTimeline(pState, &pState->graphicsTimeline, pBatch->timelineValue);
+    }
+}
+
+void createSyncObjects(AppState* pState) {
+    VkSemaphoreCreateInfo semaphoreInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+    };
+
+    // Presentation only takes binary semaphores, everything else orders itself on the queue timeline.
+    if (vkCreateSemaphore(pState->device, &semaphoreInfo, NULL, &pState->imageAvailableSemaphore) != VK_SUCCESS ||
+        vkCreateSemaphore(pState->device, &semaphoreInfo, NULL, &pState->renderFinishedSemaphore) != VK_SUCCESS) {
+        printf("%s - failed to create synchronization objects for a frame!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_SEMAPHORE, VK_SEMAPHORE_TYPE_BINARY, 0, 0, NULL);
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_SEMAPHORE, VK_SEMAPHORE_TYPE_BINARY, 0, 0, NULL);
+
+    createQueueTimeline(pState, &pState->graphicsTimeline, pState->queue);
+}
+
+void createDescriptorPool(AppState* pState) {
+    VkDescriptorPoolSize poolSizes[] = {
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 32},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8},
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+            .maxSets = 16,
+            .poolSizeCount = sizeof(poolSizes) / sizeof(poolSizes[0]),
+            .pPoolSizes = poolSizes,
+    };
+
+    if (vkCreateDescriptorPool(pState->device, &poolInfo, NULL, &pState->descriptorPool) != VK_SUCCESS) {
+        printf("%s - failed to create descriptor pool!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_DESCRIPTOR_POOL, poolInfo.maxSets, poolInfo.poolSizeCount, 0, NULL);
+}
+
+void createBuffer(AppState* pState, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer* pBuffer, VkDeviceMemory* pBufferMemory) {
+    VkBufferCreateInfo bufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = size,
+            .usage = usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    if (vkCreateBuffer(pState->device, &bufferInfo, NULL, pBuffer) != VK_SUCCESS) {
+        printf("%s - failed to create buffer!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_BUFFER, size, usage, properties, NULL);
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(pState->device, *pBuffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = memRequirements.size,
+            .memoryTypeIndex = findMemoryType(pState, memRequirements.memoryTypeBits, properties),
+    };
+
+    if (vkAllocateMemory(pState->device, &allocInfo, NULL, pBufferMemory) != VK_SUCCESS) {
+        printf("%s - failed to allocate buffer memory!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_MEMORY, allocInfo.allocationSize, allocInfo.memoryTypeIndex, properties, NULL);
+
+    vkBindBufferMemory(pState->device, *pBuffer, *pBufferMemory, 0);
+}
+
+VkCommandBuffer beginSingleTimeCommands(AppState* pState) {
+    VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandPool = pState->commandPool,
+            .commandBufferCount = 1,
+    };
+
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(pState->device, &allocInfo, &commandBuffer);
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_COMMAND_BUFFER, allocInfo.level, allocInfo.commandBufferCount, 0, NULL);
+
+    VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    return commandBuffer;
+}
+
+void endSingleTimeCommands(AppState* pState, VkCommandBuffer commandBuffer) {
+    vkEndCommandBuffer(commandBuffer);
+
+    QueueSubmitDesc submitDesc = {
+            .commandBufferCount = 1,
+            .pCommandBuffers = &commandBuffer,
+    };
+    waitForTimeline(pState, &pState->graphicsTimeline, submitToTimeline(pState, &pState->graphicsTimeline, &submitDesc));
+
+    vkFreeCommandBuffers(pState->device, pState->commandPool, 1, &commandBuffer);
+}
+
+void createUploadContext(AppState* pState) {
+    UploadContext* pUpload = &pState->upload;
+    pUpload->slotSize = UPLOAD_SLOT_SIZE;
+
+    createBuffer(pState, pUpload->slotSize * UPLOAD_SLOT_COUNT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &pUpload->stagingBuffer, &pUpload->stagingBufferMemory);
+    vkMapMemory(pState->device, pUpload->stagingBufferMemory, 0, VK_WHOLE_SIZE, 0, (void**) &pUpload->pStagingData);
+
+    VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pState->commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = UPLOAD_SLOT_COUNT,
+    };
+    if (vkAllocateCommandBuffers(pState->device, &allocInfo, pUpload->commandBuffers) != VK_SUCCESS) {
+        printf("%s - failed to allocate upload command buffers!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_COMMAND_BUFFER, allocInfo.level, allocInfo.commandBufferCount, 0, NULL);
+}
+
+// Streams pSrc into dstBuffer through the staging slots. While the GPU copies one slot the CPU fills the next, so
+// when pSrc is a mapped file the page faults reading it overlap with the transfers.
+void uploadBuffer(AppState* pState, VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* pSrc, VkDeviceSize size) {
+    UploadContext* pUpload = &pState->upload;
+    const uint8_t* pSrcBytes = pSrc;
+
+    if (pUpload->trackHeapPeak) {
+        size_t heapBytes = getHeapBytesInUse();
+        pUpload->peakHeapBytes = heapBytes > pUpload->peakHeapBytes ? heapBytes : pUpload->peakHeapBytes;
+    }
+
+    for (VkDeviceSize offset = 0; offset < size; offset += pUpload->slotSize) {
+        uint32_t slot = pUpload->nextSlot;
+        pUpload->nextSlot = (pUpload->nextSlot + 1) % UPLOAD_SLOT_COUNT;
+
+        waitForTimeline(pState, &pState->graphicsTimeline, pUpload->slotValues[slot]);
+
+        VkDeviceSize chunkSize = size - offset < pUpload->slotSize ? size - offset : pUpload->slotSize;
+        memcpy(pUpload->pStagingData + slot * pUpload->slotSize, pSrcBytes + offset, chunkSize);
+
+        VkCommandBuffer commandBuffer = pUpload->commandBuffers[slot];
+        vkResetCommandBuffer(commandBuffer, 0);
+
+        VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        VkBufferCopy copyRegion = {
+                .srcOffset = slot * pUpload->slotSize,
+                .dstOffset = dstOffset + offset,
+                .size = chunkSize,
+        };
+        vkCmdCopyBuffer(commandBuffer, pUpload->stagingBuffer, dstBuffer, 1, &copyRegion);
+
+        vkEndCommandBuffer(commandBuffer);
+
+        QueueSubmitDesc submitDesc = {
+                .commandBufferCount = 1,
+                .pCommandBuffers = &commandBuffer,
+        };
+        pUpload->slotValues[slot] = submitToTimeline(pState, &pState->graphicsTimeline, &submitDesc);
+
+        pUpload->uploadedBytes += chunkSize;
+    }
+}
+
+void waitForUploads(AppState* pState) {
+    for (int i = 0; i < UPLOAD_SLOT_COUNT; ++i) {
+        waitForTimeline(pState, &pState->graphicsTimeline, pState->upload.slotValues[i]);
+    }
+}
+
+void destroyUploadContext(AppState* pState) {
+    UploadContext* pUpload = &pState->upload;
+
+    vkFreeCommandBuffers(pState->device, pState->commandPool, UPLOAD_SLOT_COUNT, pUpload->commandBuffers);
+
+    vkUnmapMemory(pState->device, pUpload->stagingBufferMemory);
+    vkDestroyBuffer(pState->device, pUpload->stagingBuffer, NULL);
+    vkFreeMemory(pState->device, pUpload->stagingBufferMemory, NULL);
+}
+
+void createMeshDecodePipeline(AppState* pState) {
+    VkDescriptorSetLayoutBinding bindings[] = {
+            {.binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+            {.binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+    };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = 2,
+            .pBindings = bindings,
+    };
+
+    if (vkCreateDescriptorSetLayout(pState->device, &layoutInfo, NULL, &pState->meshDecodeSetLayout) != VK_SUCCESS) {
+        printf("%s - failed to create descriptor set layout!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_DESCRIPTOR_SET_LAYOUT, layoutInfo.bindingCount, 0, 0, NULL);
+
+    VkPushConstantRange pushConstantRange = {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(MeshDecodePushConstants),
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &pState->meshDecodeSetLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    };
+
+    if (vkCreatePipelineLayout(pState->device, &pipelineLayoutInfo, NULL, &pState->meshDecodePipelineLayout) != VK_SUCCESS) {
+        printf("%s - failed to create pipeline layout!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_PIPELINE_LAYOUT, pipelineLayoutInfo.setLayoutCount, pipelineLayoutInfo.pushConstantRangeCount, 0, NULL);
+
+    uint32_t compLength;
+    char* compShaderCode = readBinaryFile("./shaders/mesh_decode.spv", &compLength);
+    VkShaderModule compShaderModule = createShaderModule(pState, compShaderCode, compLength);
+    free(compShaderCode);
+
+    VkComputePipelineCreateInfo pipelineInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .stage.module = compShaderModule,
+            .stage.pName = "main",
+            .layout = pState->meshDecodePipelineLayout,
+    };
+
+    if (vkCreateComputePipelines(pState->device, pState->pipelineCache, 1, &pipelineInfo, NULL, &pState->meshDecodePipeline) != VK_SUCCESS) {
+        printf("%s - failed to create mesh decode pipeline!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_PIPELINE, VK_PIPELINE_BIND_POINT_COMPUTE, 1, 0, "./shaders/mesh_decode.spv");
+
+    vkDestroyShaderModule(pState->device, compShaderModule, NULL);
+}
+
+void createMeshPipeline(AppState* pState) {
+    VkPushConstantRange pushConstantRange = {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(Mat4),
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 0,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    };
+
+    if (vkCreatePipelineLayout(pState->device, &pipelineLayoutInfo, NULL, &pState->meshPipelineLayout) != VK_SUCCESS) {
+        printf("%s - failed to create pipeline layout!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_PIPELINE_LAYOUT, pipelineLayoutInfo.setLayoutCount, pipelineLayoutInfo.pushConstantRangeCount, 0, NULL);
+
+    VkVertexInputBindingDescription bindingDescription = {
+            .binding = 0,
+            .stride = sizeof(MeshFloatVertex),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    };
+
+    VkVertexInputAttributeDescription attributeDescriptions[] = {
+            {.location = 0, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(MeshFloatVertex, position)},
+            {.location = 1, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(MeshFloatVertex, normal)},
+            {.location = 2, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(MeshFloatVertex, color)},
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .vertexBindingDescriptionCount = 1,
+            .pVertexBindingDescriptions = &bindingDescription,
+            .vertexAttributeDescriptionCount = 3,
+            .pVertexAttributeDescriptions = attributeDescriptions,
+    };
+
+    GraphicsPipelineDesc pipelineDesc = {
+            .shaderCount = 2,
+            .shaders = {
+                    {VK_SHADER_STAGE_VERTEX_BIT, "./shaders/mesh_vert.spv"},
+                    {VK_SHADER_STAGE_FRAGMENT_BIT, "./shaders/frag.spv"},
+            },
+            .pVertexInputState = &vertexInputInfo,
+            .layout = pState->meshPipelineLayout,
+            .renderPass = pState->renderPass,
+            .cullMode = VK_CULL_MODE_BACK_BIT,
+            .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+            .depthWriteEnable = VK_TRUE,
+            .depthCompareOp = VK_COMPARE_OP_LESS,
+            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+    pState->meshPipeline = createGraphicsPipelineFromDesc(pState, &pipelineDesc);
+}
+
+const char* getMeshletModeName(MeshletMode mode) {
+    switch (mode) {
+        case MESHLET_MODE_COMPUTE_CULL:
+            return "compute cull + indirect";
+        case MESHLET_MODE_MESH_SHADER:
+            return "mesh shader";
+        default:
+            return "single draw";
+    }
+}
+
+// Picks the meshlet draw path for the loaded mesh and builds what it needs. Both paths share one descriptor set
+// and push constant layout.
+void createMeshletPipelines(AppState* pState) {
+    const GpuMesh* pMesh = &pState->mesh;
+    if (pMesh->meshletCount == 0) {
+        return;
+    }
+
+    pState->meshletMode = pState->meshShaderSupported ? MESHLET_MODE_MESH_SHADER : MESHLET_MODE_COMPUTE_CULL;
+    pState->meshletShaderStages = pState->meshletMode == MESHLET_MODE_MESH_SHADER
+            ? VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT
+            : VK_SHADER_STAGE_COMPUTE_BIT;
+    printf("%s - drawing %u meshlets with %s\n", __FUNCTION__, pMesh->meshletCount, getMeshletModeName(pState->meshletMode));
+    if (pState->meshletMode == MESHLET_MODE_MESH_SHADER && pState->pipelineStatisticsSupported) {
+        printf("%s - pipeline statistics are not collected around mesh shader draws.\n", __FUNCTION__);
+    }
+
+    const uint32_t bindingCount = 6;
+    VkDescriptorSetLayoutBinding bindings[bindingCount];
+    for (uint32_t i = 0; i < bindingCount; ++i) {
+        VkDescriptorSetLayoutBinding binding = {
+                .binding = i,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = pState->meshletShaderStages,
+        };
+        bindings[i] = binding;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = bindingCount,
+            .pBindings = bindings,
+    };
+
+    if (vkCreateDescriptorSetLayout(pState->device, &layoutInfo, NULL, &pState->meshletSetLayout) != VK_SUCCESS) {
+        printf("%s - failed to create descriptor set layout!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_DESCRIPTOR_SET_LAYOUT, layoutInfo.bindingCount, 0, 0, NULL);
+
+    VkPushConstantRange pushConstantRange = {
+            .stageFlags = pState->meshletShaderStages,
+            .offset = 0,
+            .size = sizeof(MeshletPushConstants),
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &pState->meshletSetLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    };
+
+    if (vkCreatePipelineLayout(pState->device, &pipelineLayoutInfo, NULL, &pState->meshletPipelineLayout) != VK_SUCCESS) {
+        printf("%s - failed to create pipeline layout!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_PIPELINE_LAYOUT, pipelineLayoutInfo.setLayoutCount, pipelineLayoutInfo.pushConstantRangeCount, 0, NULL);
+
+    VkDescriptorSetAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = pState->descriptorPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &pState->meshletSetLayout,
+    };
+
+    if (vkAllocateDescriptorSets(pState->device, &allocInfo, &pState->meshletDescriptorSet) != VK_SUCCESS) {
+        printf("%s - failed to allocate descriptor set!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_DESCRIPTOR_SET, allocInfo.descriptorSetCount, bindingCount, 0, "meshlet");
+
+    // Binding order matches meshlet_common.glsl, the draw commands are only written by the compute path.
+    VkDescriptorBufferInfo bufferInfos[] = {
+            {pMesh->vertexBuffer, 0, VK_WHOLE_SIZE},
+            {pMesh->meshletBuffer.buffer, 0, VK_WHOLE_SIZE},
+            {pMesh->meshletVertexBuffer.buffer, 0, VK_WHOLE_SIZE},
+            {pMesh->meshletBoundsBuffer.buffer, 0, VK_WHOLE_SIZE},
+            {pMesh->meshletTriangleBuffer.buffer, 0, VK_WHOLE_SIZE},
+            {pMesh->drawCommandBuffer.buffer, 0, VK_WHOLE_SIZE},
+    };
+
+    VkWriteDescriptorSet descriptorWrite = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = pState->meshletDescriptorSet,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = bindingCount,
+            .pBufferInfo = bufferInfos,
+    };
+    vkUpdateDescriptorSets(pState->device, 1, &descriptorWrite, 0, NULL);
+
+    if (pState->meshletMode == MESHLET_MODE_MESH_SHADER) {
+        GraphicsPipelineDesc pipelineDesc = {
+                .shaderCount = 3,
+                .shaders = {
+                        {VK_SHADER_STAGE_TASK_BIT_EXT, "./shaders/meshlet_task.spv"},
+                        {VK_SHADER_STAGE_MESH_BIT_EXT, "./shaders/meshlet_mesh.spv"},
+                        {VK_SHADER_STAGE_FRAGMENT_BIT, "./shaders/frag.spv"},
+                },
+                .layout = pState->meshletPipelineLayout,
+                .renderPass = pState->renderPass,
+                .cullMode = VK_CULL_MODE_BACK_BIT,
+                .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+                .depthWriteEnable = VK_TRUE,
+                .depthCompareOp = VK_COMPARE_OP_LESS,
+                .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        };
+        pState->meshletMeshShaderPipeline = createGraphicsPipelineFromDesc(pState, &pipelineDesc);
+        return;
+    }
+
+    uint32_t compLength;
+    char* compShaderCode = readBinaryFile("./shaders/meshlet_cull.spv", &compLength);
+    VkShaderModule compShaderModule = createShaderModule(pState, compShaderCode, compLength);
+    free(compShaderCode);
+
+    VkComputePipelineCreateInfo pipelineInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .stage.module = compShaderModule,
+            .stage.pName = "main",
+            .layout = pState->meshletPipelineLayout,
+    };
+
+    if (vkCreateComputePipelines(pState->device, pState->pipelineCache, 1, &pipelineInfo, NULL, &pState->meshletCullPipeline) != VK_SUCCESS) {
+        printf("%s - failed to create meshlet cull pipeline!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_PIPELINE, VK_PIPELINE_BIND_POINT_COMPUTE, 1, 0, "./shaders/meshlet_cull.spv");
+
+    vkDestroyShaderModule(pState->device, compShaderModule, NULL);
+}
+
+void decodeMeshVertices(AppState* pState, VkBuffer packedBuffer, VkBuffer vertexBuffer, const MeshFileHeader* pHeader) {
+    VkDescriptorSetAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = pState->descriptorPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &pState->meshDecodeSetLayout,
+    };
+
+    VkDescriptorSet descriptorSet;
+    if (vkAllocateDescriptorSets(pState->device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        printf("%s - failed to allocate descriptor set!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_DESCRIPTOR_SET, allocInfo.descriptorSetCount, 2, 0, "mesh decode");
+
+    VkDescriptorBufferInfo bufferInfos[] = {
+            {packedBuffer, 0, VK_WHOLE_SIZE},
+            {vertexBuffer, 0, VK_WHOLE_SIZE},
+    };
+
+    VkWriteDescriptorSet descriptorWrite = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 2,
+            .pBufferInfo = bufferInfos,
+    };
+    vkUpdateDescriptorSets(pState->device, 1, &descriptorWrite, 0, NULL);
+
+    MeshDecodePushConstants pushConstants = {
+            .boundsMin = {pHeader->boundsMin[0], pHeader->boundsMin[1], pHeader->boundsMin[2], 0.0f},
+            .boundsExtent = {pHeader->boundsMax[0] - pHeader->boundsMin[0], pHeader->boundsMax[1] - pHeader->boundsMin[1], pHeader->boundsMax[2] - pHeader->boundsMin[2], 0.0f},
+            .vertexCount = pHeader->vertexCount,
+    };
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(pState);
+
+    // Covers every upload submitted before this, they all went through the same queue. Besides the decode itself
+    // the index and meshlet buffers are read later by index fetch, culling, task and mesh shaders.
+    VkMemoryBarrier uploadBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &uploadBarrier, 0, NULL, 0, NULL);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pState->meshDecodePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pState->meshDecodePipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+    vkCmdPushConstants(commandBuffer, pState->meshDecodePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (pHeader->vertexCount + MESH_DECODE_GROUP_SIZE - 1) / MESH_DECODE_GROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier decodeBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &decodeBarrier, 0, NULL, 0, NULL);
+
+    endSingleTimeCommands(pState, commandBuffer);
+
+    vkFreeDescriptorSets(pState->device, pState->descriptorPool, 1, &descriptorSet);
+}
+
+static bool uploadMeshSection(AppState* pState, const MeshFile* pMeshFile, MeshSectionType type, uint64_t expectedSize, GpuBuffer* pBuffer) {
+    uint64_t size;
+    const void* pData = findMeshSection(pMeshFile, type, &size);
+    if (pData == NULL || size == 0 || size != expectedSize) {
+        return false;
+    }
+
+    // Storage buffers are read as uint arrays, so round byte sized sections up to whole words.
+    createBuffer(pState, (size + 3) & ~(uint64_t) 3, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pBuffer->buffer, &pBuffer->memory);
+    uploadBuffer(pState, pBuffer->buffer, 0, pData, size);
+    return true;
+}
+
+void loadMeshlets(AppState* pState, const MeshFile* pMeshFile, GpuMesh* pMesh) {
+    const MeshFileHeader* pHeader = pMeshFile->pHeader;
+    if (pHeader->meshletCount == 0) {
+        return;
+    }
+
+    uint64_t meshletVertexSize;
+    if (findMeshSection(pMeshFile, MESH_SECTION_MESHLET_VERTICES, &meshletVertexSize) == NULL ||
+        !uploadMeshSection(pState, pMeshFile, MESH_SECTION_MESHLETS, (uint64_t) pHeader->meshletCount * sizeof(MeshletRange), &pMesh->meshletBuffer) ||
+        !uploadMeshSection(pState, pMeshFile, MESH_SECTION_MESHLET_BOUNDS, (uint64_t) pHeader->meshletCount * sizeof(MeshletBounds), &pMesh->meshletBoundsBuffer) ||
+        !uploadMeshSection(pState, pMeshFile, MESH_SECTION_MESHLET_VERTICES, meshletVertexSize, &pMesh->meshletVertexBuffer) ||
+        !uploadMeshSection(pState, pMeshFile, MESH_SECTION_MESHLET_TRIANGLES, pHeader->indexCount, &pMesh->meshletTriangleBuffer)) {
+        printf("%s - mesh file has no meshlet data, reconvert it to draw meshlets.\n", __FUNCTION__);
+        return;
+    }
+
+    createBuffer(pState, (VkDeviceSize) pHeader->meshletCount * sizeof(VkDrawIndexedIndirectCommand),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pMesh->drawCommandBuffer.buffer, &pMesh->drawCommandBuffer.memory);
+    pMesh->meshletCount = pHeader->meshletCount;
+}
+
+bool loadMesh(AppState* pState, const char* filename, GpuMesh* pMesh) {
+    memset(pMesh, 0, sizeof(*pMesh));
+
+    MeshFile meshFile;
+    if (!openMeshFile(filename, &meshFile)) {
+        return false;
+    }
+
+    const MeshFileHeader* pHeader = meshFile.pHeader;
+    uint64_t vertexDataSize, indexDataSize;
+    const void* pVertexData = findMeshSection(&meshFile, MESH_SECTION_VERTICES, &vertexDataSize);
+    const void* pIndexData = findMeshSection(&meshFile, MESH_SECTION_INDICES, &indexDataSize);
+
+    if (pVertexData == NULL || vertexDataSize != (uint64_t) pHeader->vertexCount * sizeof(MeshPackedVertex) ||
+        pIndexData == NULL || indexDataSize != (uint64_t) pHeader->indexCount * pHeader->indexSize) {
+        printf("%s - mesh file is missing vertex or index data! %s\n", __FUNCTION__, filename);
+        closeMeshFile(&meshFile);
+        return false;
+    }
+
+    if (pState->meshDecodePipeline == VK_NULL_HANDLE) {
+        createMeshDecodePipeline(pState);
+    }
+
+    VkBuffer packedBuffer;
+    VkDeviceMemory packedBufferMemory;
+    createBuffer(pState, vertexDataSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &packedBuffer, &packedBufferMemory);
+
+    pMesh->vertexDataSize = (VkDeviceSize) pHeader->vertexCount * sizeof(MeshFloatVertex);
+    createBuffer(pState, pMesh->vertexDataSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pMesh->vertexBuffer, &pMesh->vertexBufferMemory);
+
+    pMesh->indexDataSize = indexDataSize;
+    createBuffer(pState, indexDataSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pMesh->indexBuffer, &pMesh->indexBufferMemory);
+
+    uploadBuffer(pState, packedBuffer, 0, pVertexData, vertexDataSize);
+    uploadBuffer(pState, pMesh->indexBuffer, 0, pIndexData, indexDataSize);
+    loadMeshlets(pState, &meshFile, pMesh);
+    decodeMeshVertices(pState, packedBuffer, pMesh->vertexBuffer, pHeader);
+
+    vkDestroyBuffer(pState->device, packedBuffer, NULL);
+    vkFreeMemory(pState->device, packedBufferMemory, NULL);
+
+    pMesh->indexType = pHeader->indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    pMesh->indexCount = pHeader->indexCount;
+    pMesh->vertexCount = pHeader->vertexCount;
+    memcpy(pMesh->boundsMin, pHeader->boundsMin, sizeof(pMesh->boundsMin));
+    memcpy(pMesh->boundsMax, pHeader->boundsMax, sizeof(pMesh->boundsMax));
+
+    closeMeshFile(&meshFile);
+    return true;
+}
+
+// The naive path the compact format is measured against: read the whole float file into memory and upload it as is.
+bool loadRawMesh(AppState* pState, const char* filename, GpuMesh* pMesh) {
+    memset(pMesh, 0, sizeof(*pMesh));
+
+    uint32_t fileLength;
+    char* pContents = readBinaryFile(filename, &fileLength);
+    if (pContents == NULL) {
+        return false;
+    }
+    const RawMeshHeader* pHeader = (const RawMeshHeader*) pContents;
+    if (fileLength < sizeof(RawMeshHeader) || pHeader->magic != RAW_MESH_FILE_MAGIC || pHeader->vertexCount == 0 || pHeader->indexCount == 0) {
+        printf("%s - not a raw mesh file! %s\n", __FUNCTION__, filename);
+        free(pContents);
+        return false;
+    }
+
+    // The counts are 32 bit, so the section sizes fit in 64 bits, but the sum is compared without wrapping.
+    uint64_t payloadSize = fileLength - sizeof(RawMeshHeader);
+    uint64_t vertexDataSize = (uint64_t) pHeader->vertexCount * sizeof(MeshFloatVertex);
+    uint64_t indexDataSize = (uint64_t) pHeader->indexCount * sizeof(uint32_t);
+    if (vertexDataSize > payloadSize || indexDataSize > payloadSize - vertexDataSize) {
+        printf("%s - raw mesh file is truncated! %s\n", __FUNCTION__, filename);
+        free(pContents);
+        return false;
+    }
+    pMesh->vertexDataSize = vertexDataSize;
+    pMesh->indexDataSize = indexDataSize;
+
+    createBuffer(pState, pMesh->vertexDataSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pMesh->vertexBuffer, &pMesh->vertexBufferMemory);
+    createBuffer(pState, pMesh->indexDataSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pMesh->indexBuffer, &pMesh->indexBufferMemory);
+
+    const char* pVertexData = pContents + sizeof(RawMeshHeader);
+    uploadBuffer(pState, pMesh->vertexBuffer, 0, pVertexData, pMesh->vertexDataSize);
+    uploadBuffer(pState, pMesh->indexBuffer, 0, pVertexData + pMesh->vertexDataSize, pMesh->indexDataSize);
+    waitForUploads(pState);
+
+    pMesh->indexType = VK_INDEX_TYPE_UINT32;
+    pMesh->indexCount = pHeader->indexCount;
+    pMesh->vertexCount = pHeader->vertexCount;
+
+    free(pContents);
+    return true;
+}
+
+void destroyGpuBuffer(AppState* pState, GpuBuffer* pBuffer) {
+    vkDestroyBuffer(pState->device, pBuffer->buffer, NULL);
+    vkFreeMemory(pState->device, pBuffer->memory, NULL);
+}
+
+void destroyGpuMesh(AppState* pState, GpuMesh* pMesh) {
+    destroyGpuBuffer(pState, &pMesh->meshletBuffer);
+    destroyGpuBuffer(pState, &pMesh->meshletBoundsBuffer);
+    destroyGpuBuffer(pState, &pMesh->meshletVertexBuffer);
+    destroyGpuBuffer(pState, &pMesh->meshletTriangleBuffer);
+    destroyGpuBuffer(pState, &pMesh->drawCommandBuffer);
+    vkDestroyBuffer(pState->device, pMesh->indexBuffer, NULL);
+    vkFreeMemory(pState->device, pMesh->indexBufferMemory, NULL);
+    vkDestroyBuffer(pState->device, pMesh->vertexBuffer, NULL);
+    vkFreeMemory(pState->device, pMesh->vertexBufferMemory, NULL);
+    memset(pMesh, 0, sizeof(*pMesh));
+}
+
+// Starts tracking the heap peak of a load, measured from the heap in use now.
+size_t beginHeapPeak(AppState* pState) {
+    size_t baseline = getHeapBytesInUse();
+    pState->upload.trackHeapPeak = true;
+    pState->upload.peakHeapBytes = baseline;
+    return baseline;
+}
+
+// Heap bytes the load held on top of the baseline at its peak, including what it still holds now.
+size_t endHeapPeak(AppState* pState, size_t baseline) {
+    size_t heapBytes = getHeapBytesInUse();
+    size_t peak = heapBytes > pState->upload.peakHeapBytes ? heapBytes : pState->upload.peakHeapBytes;
+    pState->upload.trackHeapPeak = false;
+    return peak > baseline ? peak - baseline : 0;
+}
+
+void benchmarkMeshLoading(AppState* pState, const char* meshFilename, const char* rawFilename) {
+    const int iterationCount = 5;
+    GpuMesh mesh;
+
+    MappedFile meshMapping, rawMapping;
+    if (!mapFile(meshFilename, &meshMapping) || !mapFile(rawFilename, &rawMapping)) {
+        return;
+    }
+    size_t meshFileSize = meshMapping.size;
+    size_t rawFileSize = rawMapping.size;
+    unmapFile(&meshMapping);
+    unmapFile(&rawMapping);
+
+    // First iteration of each warms the page cache so both paths are measured from memory, not the disk.
+    // The heap is sampled on an extra untimed iteration so the sampling does not show up in the load times.
+    double packedSeconds = 0.0;
+    VkDeviceSize packedUploadBytes = 0;
+    VkDeviceSize packedResidentBytes = 0;
+    size_t packedHeapBytes = 0;
+    for (int i = 0; i <= iterationCount + 1; ++i) {
+        VkDeviceSize uploadedBefore = pState->upload.uploadedBytes;
+        size_t heapBaseline = i == iterationCount + 1 ? beginHeapPeak(pState) : 0;
+        double start = getTimeSeconds();
+        bool loaded = loadMesh(pState, meshFilename, &mesh);
+        double seconds = getTimeSeconds() - start;
+        if (i == iterationCount + 1) {
+            packedHeapBytes = endHeapPeak(pState, heapBaseline);
+        }
+        if (!loaded) {
+            return;
+        }
+        if (i > 0 && i <= iterationCount) {
+            packedSeconds += seconds;
+        }
+        packedUploadBytes = pState->upload.uploadedBytes - uploadedBefore;
+        packedResidentBytes = mesh.vertexDataSize + mesh.indexDataSize;
+        destroyGpuMesh(pState, &mesh);
+    }
+
+    double rawSeconds = 0.0;
+    VkDeviceSize rawUploadBytes = 0;
+    VkDeviceSize rawResidentBytes = 0;
+    size_t rawHeapBytes = 0;
+    for (int i = 0; i <= iterationCount + 1; ++i) {
+        VkDeviceSize uploadedBefore = pState->upload.uploadedBytes;
+        size_t heapBaseline = i == iterationCount + 1 ? beginHeapPeak(pState) : 0;
+        double start = getTimeSeconds();
+        bool loaded = loadRawMesh(pState, rawFilename, &mesh);
+        double seconds = getTimeSeconds() - start;
+        if (i == iterationCount + 1) {
+            rawHeapBytes = endHeapPeak(pState, heapBaseline);
+        }
+        if (!loaded) {
+            return;
+        }
+        if (i > 0 && i <= iterationCount) {
+            rawSeconds += seconds;
+        }
+        rawUploadBytes = pState->upload.uploadedBytes - uploadedBefore;
+        rawResidentBytes = mesh.vertexDataSize + mesh.indexDataSize;
+        destroyGpuMesh(pState, &mesh);
+    }
+
+    // Peak heap is what the process allocated during the load on top of what it held before, driver allocations
+    // included. Mapped file pages are not heap and do not count.
+    printf("%s - compact: %.3f ms load, %zu file bytes, %zu peak heap bytes, %llu upload bytes, %llu gpu bytes\n", __FUNCTION__,
+           packedSeconds * 1000.0 / iterationCount, meshFileSize, packedHeapBytes,
+           (unsigned long long) packedUploadBytes, (unsigned long long) packedResidentBytes);
+    printf("%s - naive float: %.3f ms load, %zu file bytes, %zu peak heap bytes, %llu upload bytes, %llu gpu bytes\n", __FUNCTION__,
+           rawSeconds * 1000.0 / iterationCount, rawFileSize, rawHeapBytes,
+           (unsigned long long) rawUploadBytes, (unsigned long long) rawResidentBytes);
+}
+
+// Submits an empty command buffer over and over, keeping up to depth submits in flight, once with a fence per
+// submit slot and once through a queue timeline. What is left is the cost of the synchronisation itself.
+void benchmarkSynchronization(AppState* pState) {
+    const uint32_t submitCount = 20000;
+    const uint32_t depths[] = {1, 3};
+
+    VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pState->commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+    };
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(pState->device, &allocInfo, &commandBuffer);
+
+    VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+    };
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    vkEndCommandBuffer(commandBuffer);
+
+    for (uint32_t d = 0; d < sizeof(depths) / sizeof(depths[0]); ++d) {
+        const uint32_t depth = depths[d];
+
+        VkFence fences[depth];
+        VkFenceCreateInfo fenceInfo = {
+                .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+        };
+        for (uint32_t i = 0; i < depth; ++i) {
+            vkCreateFence(pState->device, &fenceInfo, NULL, &fences[i]);
+        }
+
+        VkSubmitInfo submitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &commandBuffer,
+        };
+
+        double start = getTimeSeconds();
+        for (uint32_t i = 0; i < submitCount; ++i) {
+            VkFence fence = fences[i % depth];
+            vkWaitForFences(pState->device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(pState->device, 1, &fence);
+            vkQueueSubmit(pState->queue, 1, &submitInfo, fence);
+        }
+        vkWaitForFences(pState->device, depth, fences, VK_TRUE, UINT64_MAX);
+        double fenceSeconds = getTimeSeconds() - start;
+
+        for (uint32_t i = 0; i < depth; ++i) {
+            vkDestroyFence(pState->device, fences[i], NULL);
+        }
+
+        QueueTimeline timeline;
+        createQueueTimeline(pState, &timeline, pState->queue);
+
+        QueueSubmitDesc submitDesc = {
+                .commandBufferCount = 1,
+                .pCommandBuffers = &commandBuffer,
+        };
+
+        start = getTimeSeconds();
+        for (uint32_t i = 0; i < submitCount; ++i) {
+            if (timeline.lastSubmittedValue >= depth) {
+                waitForTimeline(pState, &timeline, timeline.lastSubmittedValue + 1 - depth);
+            }
+            submitToTimeline(pState, &timeline, &submitDesc);
+        }
+        waitForTimeline(pState, &timeline, timeline.lastSubmittedValue);
+        double timelineSeconds = getTimeSeconds() - start;
+
+        destroyQueueTimeline(pState, &timeline);
+
+        printf("%s - %u in flight: fence per submit %.0f submits/s, %s %.0f submits/s\n", __FUNCTION__, depth,
+               (double) submitCount / fenceSeconds,
+               pState->timelineSemaphoreSupported ? "timeline semaphore" : "timeline (fence fallback)",
+               (double) submitCount / timelineSeconds);
+    }
+
+    vkFreeCommandBuffers(pState->device, pState->commandPool, 1, &commandBuffer);
+}
+
+// pCameraPosition receives the eye in mesh space, which is where the meshlet bounds live. May be NULL.
+void computeMeshTransform(AppState* pState, Mat4* pMvp, Vec3* pCameraPosition) {
+    const GpuMesh* pMesh = &pState->mesh;
+
+    // Fit the mesh bounds into a unit cube at the origin.
+    Vec3 center = {
+            (pMesh->boundsMin[0] + pMesh->boundsMax[0]) * 0.5f,
+            (pMesh->boundsMin[1] + pMesh->boundsMax[1]) * 0.5f,
+            (pMesh->boundsMin[2] + pMesh->boundsMax[2]) * 0.5f,
+    };
+    float extent = fmaxf(pMesh->boundsMax[0] - pMesh->boundsMin[0], fmaxf(pMesh->boundsMax[1] - pMesh->boundsMin[1], pMesh->boundsMax[2] - pMesh->boundsMin[2]));
+    float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+    Mat4 translation = mat4Translation((Vec3) {-center.x, -center.y, -center.z});
+    Mat4 scaling = mat4Scale((Vec3) {scale, scale, scale});
+    Mat4 rotation = mat4RotationY(0.6f);
+    Mat4 model = mat4Multiply(&scaling, &translation);
+    model = mat4Multiply(&rotation, &model);
+
+    Vec3 eye = {0.0f, 0.6f, 1.6f};
+    Mat4 view = mat4LookAt(eye, (Vec3) {0.0f, 0.0f, 0.0f}, (Vec3) {0.0f, 1.0f, 0.0f});
+    Mat4 projection = mat4Perspective(1.0f, (float) pState->swapChainExtent.width / (float) pState->swapChainExtent.height, 0.05f, 10.0f);
+
+    Mat4 viewProjection = mat4Multiply(&projection, &view);
+    *pMvp = mat4Multiply(&viewProjection, &model);
+
+    if (pCameraPosition != NULL) {
+        Mat4 inverseTranslation = mat4Translation(center);
+        Mat4 inverseScaling = mat4Scale((Vec3) {1.0f / scale, 1.0f / scale, 1.0f / scale});
+        Mat4 inverseRotation = mat4RotationY(-0.6f);
+        Mat4 inverseModel = mat4Multiply(&inverseScaling, &inverseRotation);
+        inverseModel = mat4Multiply(&inverseTranslation, &inverseModel);
+        *pCameraPosition = mat4TransformPoint(&inverseModel, eye);
+    }
+}
+
+// Runs outside the render pass: one thread per meshlet rewrites that meshlet's indirect draw.
+void recordMeshletCull(AppState* pState, const MeshletPushConstants* pPushConstants) {
+    VkCommandBuffer commandBuffer = pState->commandBuffer;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pState->meshletCullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pState->meshletPipelineLayout, 0, 1, &pState->meshletDescriptorSet, 0, NULL);
+    vkCmdPushConstants(commandBuffer, pState->meshletPipelineLayout, pState->meshletShaderStages, 0, sizeof(*pPushConstants), pPushConstants);
+    vkCmdDispatch(commandBuffer, (pState->mesh.meshletCount + MESHLET_CULL_GROUP_SIZE - 1) / MESHLET_CULL_GROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier cullBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &cullBarrier, 0, NULL, 0, NULL);
+}
+
+void recordMeshDraw(AppState* pState, const MeshletPushConstants* pPushConstants) {
+    VkCommandBuffer commandBuffer = pState->commandBuffer;
+    const GpuMesh* pMesh = &pState->mesh;
+
+    VkViewport viewport = {
+            .x = 0.0f,
+            .y = 0.0f,
+            .width = (float) pState->renderExtent.width,
+            .height = (float) pState->renderExtent.height,
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+    };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    if (pState->meshletMode == MESHLET_MODE_MESH_SHADER) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pState->meshletMeshShaderPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pState->meshletPipelineLayout, 0, 1, &pState->meshletDescriptorSet, 0, NULL);
+        vkCmdPushConstants(commandBuffer, pState->meshletPipelineLayout, pState->meshletShaderStages, 0, sizeof(*pPushConstants), pPushConstants);
+        vkCmdDrawMeshTasksEXT(commandBuffer, (pMesh->meshletCount + MESHLET_TASK_GROUP_SIZE - 1) / MESHLET_TASK_GROUP_SIZE, 1, 1);
+        return;
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pState->meshPipeline);
+    vkCmdPushConstants(commandBuffer, pState->meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pPushConstants->mvp), &pPushConstants->mvp);
+
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &pMesh->vertexBuffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, pMesh->indexBuffer, 0, pMesh->indexType);
+
+    if (pState->meshletMode == MESHLET_MODE_COMPUTE_CULL) {
+        // Culled meshlets have an index count of zero, so the draw count stays fixed and no count buffer is needed.
+        for (uint32_t first = 0; first < pMesh->meshletCount; first += pState->maxDrawIndirectCount) {
+            uint32_t drawCount = pMesh->meshletCount - first < pState->maxDrawIndirectCount ? pMesh->meshletCount - first : pState->maxDrawIndirectCount;
+            vkCmdDrawIndexedIndirect(commandBuffer, pMesh->drawCommandBuffer.buffer, first * sizeof(VkDrawIndexedIndirectCommand),
+                                     drawCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    } else {
+        vkCmdDrawIndexed(commandBuffer, pMesh->indexCount, 1, 0, 0, 0);
+    }
+}
+
+// Backs the virtual texture with one sparse image whose pages are bound from a fixed pool allocation. Only taken
+// when the device uses the standard 128 x 128 block shape for RGBA8 and has no mip tail within our mip range.
+bool createSparseVirtualTextureImage(AppState* pState) {
+    VirtualTextureResources* pTexture = &pState->virtualTexture;
+    const VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    uint32_t propertyCount = 0;
+    vkGetPhysicalDeviceSparseImageFormatProperties(pState->physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT,
+                                                   usage, VK_IMAGE_TILING_OPTIMAL, &propertyCount, NULL);
+    if (propertyCount == 0) {
+        return false;
+    }
+
+    VkSparseImageFormatProperties formatProperties[propertyCount];
+    vkGetPhysicalDeviceSparseImageFormatProperties(pState->physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT,
+                                                   usage, VK_IMAGE_TILING_OPTIMAL, &propertyCount, formatProperties);
+    if (formatProperties[0].imageGranularity.width != VT_PAGE_SIZE || formatProperties[0].imageGranularity.height != VT_PAGE_SIZE) {
+        return false;
+    }
+
+    VkImageCreateInfo imageInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .extent.width = VT_VIRTUAL_SIZE,
+            .extent.height = VT_VIRTUAL_SIZE,
+            .extent.depth = 1,
+            .mipLevels = VT_MIP_COUNT,
+            .arrayLayers = 1,
+            .format = VK_FORMAT_R8G8B8A8_UNORM,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .usage = usage,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    if (vkCreateImage(pState->device, &imageInfo, NULL, &pTexture->physicalImage) != VK_SUCCESS) {
+        printf("%s - failed to create sparse image!\n", __FUNCTION__);
+        return false;
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_IMAGE, (uint64_t) VT_VIRTUAL_SIZE << 32 | VT_VIRTUAL_SIZE,
+                         (uint64_t) VK_FORMAT_R8G8B8A8_UNORM << 32 | VT_MIP_COUNT, usage, "sparse");
+
+    uint32_t requirementCount = 0;
+    vkGetImageSparseMemoryRequirements(pState->device, pTexture->physicalImage, &requirementCount, NULL);
+    VkSparseImageMemoryRequirements sparseRequirements[requirementCount > 0 ? requirementCount : 1];
+    vkGetImageSparseMemoryRequirements(pState->device, pTexture->physicalImage, &requirementCount, sparseRequirements);
+
+    bool hasMipTail = false;
+    for (uint32_t i = 0; i < requirementCount; ++i) {
+        if ((sparseRequirements[i].formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) &&
+            sparseRequirements[i].imageMipTailFirstLod < VT_MIP_COUNT) {
+            hasMipTail = true;
+        }
+    }
+
+    // The mip tail is never bound, so a tail covering any of our mips (the smallest ones, on most hardware) means the pool.
+    if (requirementCount == 0 || hasMipTail) {
+        if (hasMipTail) {
+            printf("%s - mip tail covers the smallest mips, using the indirection pool!\n", __FUNCTION__);
+        }
+        vkDestroyImage(pState->device, pTexture->physicalImage, NULL);
+        pTexture->physicalImage = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(pState->device, pTexture->physicalImage, &memRequirements);
+
+    // The budget: every slot is one sparse block, however large the virtual image is.
+    pTexture->sparsePageSize = memRequirements.alignment;
+    pTexture->physicalMemorySize = pTexture->sparsePageSize * VT_POOL_SLOT_COUNT;
+
+    VkMemoryAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = pTexture->physicalMemorySize,
+            .memoryTypeIndex = findMemoryType(pState, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+
+    if (vkAllocateMemory(pState->device, &allocInfo, NULL, &pTexture->physicalMemory) != VK_SUCCESS) {
+        printf("%s - failed to allocate sparse page pool!\n", __FUNCTION__);
+        vkDestroyImage(pState->device, pTexture->physicalImage, NULL);
+        pTexture->physicalImage = VK_NULL_HANDLE;
+        return false;
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_MEMORY, allocInfo.allocationSize, allocInfo.memoryTypeIndex, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, NULL);
+
+    pTexture->physicalImageView = createImageView(pState, pTexture->physicalImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, VT_MIP_COUNT);
+    return true;
+}
+
+void createPooledVirtualTextureImage(AppState* pState) {
+    VirtualTextureResources* pTexture = &pState->virtualTexture;
+    const uint32_t poolSize = VT_POOL_SLOTS_PER_SIDE * VT_SLOT_SIZE;
+
+    createImage(pState, poolSize, poolSize, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &pTexture->physicalImage, &pTexture->physicalMemory);
+    pTexture->physicalMemorySize = (VkDeviceSize) poolSize * poolSize * 4;
+    pTexture->physicalImageView = createImageView(pState, pTexture->physicalImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
+VkSparseImageMemoryBind getSparsePageBind(VirtualTextureResources* pTexture, uint32_t pageIndex, int32_t slot) {
+    uint32_t mip, pageX, pageY;
+    getVirtualTexturePageCoords(pageIndex, &mip, &pageX, &pageY);
+
+    VkSparseImageMemoryBind bind = {
+            .subresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0},
+            .offset = {(int32_t) (pageX * VT_PAGE_SIZE), (int32_t) (pageY * VT_PAGE_SIZE), 0},
+            .extent = {VT_PAGE_SIZE, VT_PAGE_SIZE, 1},
+            .memory = slot >= 0 ? pTexture->physicalMemory : VK_NULL_HANDLE,
+            .memoryOffset = slot >= 0 ? (VkDeviceSize) slot * pTexture->sparsePageSize : 0,
+    };
+    return bind;
+}
+
+// Gives each page a slot, fills it from the page source and uploads it together with the rebuilt page table. The
+// upload is queued ahead of the next frame and goes out in the same submit call, so that frame already samples the
+// new pages.
+void pageInVirtualTexture(AppState* pState, const uint32_t* pPages, uint32_t pageCount, uint32_t stamp) {
+    VirtualTextureResources* pTexture = &pState->virtualTexture;
+    VirtualTexture* pResidency = pTexture->pResidency;
+
+    const uint32_t border = pTexture->sparse ? 0 : VT_PAGE_BORDER;
+    const uint32_t slotSize = VT_PAGE_SIZE + 2 * border;
+    const VkDeviceSize slotBytes = (VkDeviceSize) slotSize * slotSize * 4;
+    const VkDeviceSize pageTableOffset = (VkDeviceSize) VT_MAX_PAGE_INS_PER_FRAME * VT_SLOT_SIZE * VT_SLOT_SIZE * 4;
+
+    VkSparseImageMemoryBind* binds = pTexture->sparseBinds;
+    uint32_t bindCount = 0;
+    VkBufferImageCopy copies[VT_MAX_PAGE_INS_PER_FRAME + VT_MIP_COUNT];
+    uint32_t copyCount = 0;
+    double now = getTimeSeconds();
+
+    for (uint32_t i = 0; i < pageCount && i < VT_MAX_PAGE_INS_PER_FRAME; ++i) {
+        int32_t evictedPage;
+        int32_t slot = allocateVirtualTextureSlot(pResidency, pPages[i], stamp, now, &evictedPage);
+        if (slot < 0) {
+            break;
+        }
+
+        if (pTexture->sparse) {
+            if (evictedPage >= 0) {
+                binds[bindCount++] = getSparsePageBind(pTexture, evictedPage, -1);
+            }
+            binds[bindCount++] = getSparsePageBind(pTexture, pPages[i], slot);
+        }
+
+        generateVirtualTexturePage(pPages[i], border, pTexture->pStagingData + copyCount * slotBytes);
+
+        uint32_t mip, pageX, pageY;
+        getVirtualTexturePageCoords(pPages[i], &mip, &pageX, &pageY);
+
+        VkBufferImageCopy copy = {
+                .bufferOffset = copyCount * slotBytes,
+                .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, pTexture->sparse ? mip : 0, 0, 1},
+                .imageExtent = {slotSize, slotSize, 1},
+        };
+        if (pTexture->sparse) {
+            copy.imageOffset = (VkOffset3D) {(int32_t) (pageX * VT_PAGE_SIZE), (int32_t) (pageY * VT_PAGE_SIZE), 0};
+        } else {
+            copy.imageOffset = (VkOffset3D) {(slot % VT_POOL_SLOTS_PER_SIDE) * VT_SLOT_SIZE, (slot / VT_POOL_SLOTS_PER_SIDE) * VT_SLOT_SIZE, 0};
+        }
+        copies[copyCount++] = copy;
+    }
+
+    if (copyCount == 0 && !pResidency->pageTableDirty) {
+        return;
+    }
+
+    buildVirtualTexturePageTable(pResidency);
+    memcpy(pTexture->pStagingData + pageTableOffset, pResidency->pageTable, sizeof(pResidency->pageTable));
+
+    // The bind infos live next to the binds, the submit layer reads them when it flushes.
+    pTexture->sparseImageBindInfo = (VkSparseImageMemoryBindInfo) {
+            .image = pTexture->physicalImage,
+            .bindCount = bindCount,
+            .pBinds = binds,
+    };
+    pTexture->bindSparseInfo = (VkBindSparseInfo) {
+            .sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO,
+            .imageBindCount = 1,
+            .pImageBinds = &pTexture->sparseImageBindInfo,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &pTexture->bindSemaphore,
+    };
+
+    VkCommandBuffer commandBuffer = pTexture->commandBuffer;
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    // Both images live in GENERAL so pages can be copied in while the rest of the texture stays in use.
+    if (copyCount > 0) {
+        vkCmdCopyBufferToImage(commandBuffer, pTexture->stagingBuffer, pTexture->physicalImage, VK_IMAGE_LAYOUT_GENERAL, copyCount, copies);
+    }
+
+    VkBufferImageCopy pageTableCopies[VT_MIP_COUNT];
+    for (uint32_t mip = 0; mip < VT_MIP_COUNT; ++mip) {
+        uint32_t pagesPerSide = getVirtualTexturePagesPerSide(mip);
+        VkBufferImageCopy copy = {
+                .bufferOffset = pageTableOffset + getVirtualTextureMipOffset(mip) * sizeof(uint32_t),
+                .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1},
+                .imageExtent = {pagesPerSide, pagesPerSide, 1},
+        };
+        pageTableCopies[mip] = copy;
+    }
+    vkCmdCopyBufferToImage(commandBuffer, pTexture->stagingBuffer, pTexture->pageTableImage, VK_IMAGE_LAYOUT_GENERAL, VT_MIP_COUNT, pageTableCopies);
+
+    VkMemoryBarrier uploadBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &uploadBarrier, 0, NULL, 0, NULL);
+
+    vkEndCommandBuffer(commandBuffer);
+
+    SubmitBatch* pBatch = &pTexture->uploadBatch;
+    pBatch->desc = (QueueSubmitDesc) {
+            .commandBufferCount = 1,
+            .pCommandBuffers = &pTexture->commandBuffer,
+            .binaryWaitSemaphore = bindCount > 0 ? pTexture->bindSemaphore : VK_NULL_HANDLE,
+            .binaryWaitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+    };
+    pBatch->pBindSparseInfo = bindCount > 0 ? &pTexture->bindSparseInfo : NULL;
+    enqueueSubmitBatch(pState, pBatch);
+}
+
+void createVirtualTexture(AppState* pState) {
+    VirtualTextureResources* pTexture = &pState->virtualTexture;
+
+    if (!pState->fragmentStoresSupported) {
+        printf("%s - fragmentStoresAndAtomics not supported, texture streaming disabled.\n", __FUNCTION__);
+        pState->options.enableVirtualTexture = false;
+        return;
+    }
+
+    pTexture->pResidency = malloc(sizeof(VirtualTexture));
+    initVirtualTexture(pTexture->pResidency);
+
+    pTexture->sparse = pState->options.enableSparseResidency && pState->sparseResidencySupported && createSparseVirtualTextureImage(pState);
+    if (!pTexture->sparse) {
+        createPooledVirtualTextureImage(pState);
+    }
+    printf("%s - %s, %u page slots, %.1f MiB physical for a %.1f MiB virtual texture\n", __FUNCTION__,
+           pTexture->sparse ? "sparse residency" : "indirection pool", VT_POOL_SLOT_COUNT,
+           (double) pTexture->physicalMemorySize / (1024.0 * 1024.0), (double) VT_PAGE_COUNT * VT_PAGE_SIZE * VT_PAGE_SIZE * 4 / (1024.0 * 1024.0));
+
+    createImage(pState, VT_PAGES_PER_SIDE, VT_PAGES_PER_SIDE, VT_MIP_COUNT, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &pTexture->pageTableImage, &pTexture->pageTableMemory);
+    pTexture->pageTableImageView = createImageView(pState, pTexture->pageTableImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, VT_MIP_COUNT);
+
+    createBuffer(pState, VT_PAGE_COUNT * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &pTexture->feedbackBuffer, &pTexture->feedbackMemory);
+    vkMapMemory(pState->device, pTexture->feedbackMemory, 0, VT_PAGE_COUNT * sizeof(uint32_t), 0, (void**) &pTexture->pFeedback);
+    memset(pTexture->pFeedback, 0, VT_PAGE_COUNT * sizeof(uint32_t));
+
+    VkDeviceSize stagingSize = (VkDeviceSize) VT_MAX_PAGE_INS_PER_FRAME * VT_SLOT_SIZE * VT_SLOT_SIZE * 4 + VT_PAGE_COUNT * sizeof(uint32_t);
+    createBuffer(pState, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &pTexture->stagingBuffer, &pTexture->stagingMemory);
+    vkMapMemory(pState->device, pTexture->stagingMemory, 0, stagingSize, 0, (void**) &pTexture->pStagingData);
+
+    VkSamplerCreateInfo samplerInfo = {
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .magFilter = VK_FILTER_LINEAR,
+            .minFilter = VK_FILTER_LINEAR,
+            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .minLod = 0.0f,
+            .maxLod = VK_LOD_CLAMP_NONE,
+    };
+    if (vkCreateSampler(pState->device, &samplerInfo, NULL, &pTexture->linearSampler) != VK_SUCCESS) {
+        printf("%s - failed to create sampler!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_SAMPLER, samplerInfo.magFilter, samplerInfo.mipmapMode, samplerInfo.addressModeU, NULL);
+
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    if (vkCreateSampler(pState->device, &samplerInfo, NULL, &pTexture->nearestSampler) != VK_SUCCESS) {
+        printf("%s - failed to create sampler!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_SAMPLER, samplerInfo.magFilter, samplerInfo.mipmapMode, samplerInfo.addressModeU, NULL);
+
+    VkCommandBufferAllocateInfo commandBufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pState->commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+    };
+    if (vkAllocateCommandBuffers(pState->device, &commandBufferInfo, &pTexture->commandBuffer) != VK_SUCCESS) {
+        printf("%s - failed to allocate command buffer!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_COMMAND_BUFFER, commandBufferInfo.level, commandBufferInfo.commandBufferCount, 0, NULL);
+
+    VkSemaphoreCreateInfo semaphoreInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    if (vkCreateSemaphore(pState->device, &semaphoreInfo, NULL, &pTexture->bindSemaphore) != VK_SUCCESS) {
+        printf("%s - failed to create semaphore!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_SEMAPHORE, VK_SEMAPHORE_TYPE_BINARY, 0, 0, NULL);
+
+    // Neither image is ever transitioned again, see pageInVirtualTexture.
+    VkImageMemoryBarrier layoutBarriers[2];
+    VkImage images[2] = {pTexture->physicalImage, pTexture->pageTableImage};
+    for (int i = 0; i < 2; ++i) {
+        VkImageMemoryBarrier barrier = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = images[i],
+                .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1},
+        };
+        layoutBarriers[i] = barrier;
+    }
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(pState);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, NULL, 0, NULL, 2, layoutBarriers);
+    endSingleTimeCommands(pState, commandBuffer);
+
+    VkDescriptorSetLayoutBinding bindings[] = {
+            {.binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
+            {.binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
+            {.binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
+    };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = 3,
+            .pBindings = bindings,
+    };
+    if (vkCreateDescriptorSetLayout(pState->device, &layoutInfo, NULL, &pTexture->setLayout) != VK_SUCCESS) {
+        printf("%s - failed to create descriptor set layout!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_DESCRIPTOR_SET_LAYOUT, layoutInfo.bindingCount, 0, 0, NULL);
+
+    VkPushConstantRange pushConstantRange = {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+            .offset = 0,
+            .size = sizeof(VirtualTexturePushConstants),
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &pTexture->setLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    };
+    if (vkCreatePipelineLayout(pState->device, &pipelineLayoutInfo, NULL, &pTexture->pipelineLayout) != VK_SUCCESS) {
+        printf("%s - failed to create pipeline layout!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_PIPELINE_LAYOUT, pipelineLayoutInfo.setLayoutCount, pipelineLayoutInfo.pushConstantRangeCount, 0, NULL);
+
+    VkDescriptorSetAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = pState->descriptorPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &pTexture->setLayout,
+    };
+    if (vkAllocateDescriptorSets(pState->device, &allocInfo, &pTexture->descriptorSet) != VK_SUCCESS) {
+        printf("%s - failed to allocate descriptor set!\n", __FUNCTION__);
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_DESCRIPTOR_SET, allocInfo.descriptorSetCount, layoutInfo.bindingCount, 0, "virtual texture");
+
+    VkDescriptorImageInfo imageInfos[] = {
+            {pTexture->nearestSampler, pTexture->pageTableImageView, VK_IMAGE_LAYOUT_GENERAL},
+            {pTexture->linearSampler, pTexture->physicalImageView, VK_IMAGE_LAYOUT_GENERAL},
+    };
+    VkDescriptorBufferInfo feedbackInfo = {pTexture->feedbackBuffer, 0, VK_WHOLE_SIZE};
+
+    VkWriteDescriptorSet descriptorWrites[] = {
+            {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = pTexture->descriptorSet,
+                    .dstBinding = 0,
+                    .descriptorCount = 2,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .pImageInfo = imageInfos,
+            },
+            {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = pTexture->descriptorSet,
+                    .dstBinding = 2,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pBufferInfo = &feedbackInfo,
+            },
+    };
+    vkUpdateDescriptorSets(pState->device, 2, descriptorWrites, 0, NULL);
+
+    GraphicsPipelineDesc pipelineDesc = {
+            .shaderCount = 2,
+            .shaders = {
+                    {VK_SHADER_STAGE_VERTEX_BIT, "./shaders/virtual_texture_vert.spv"},
+                    {VK_SHADER_STAGE_FRAGMENT_BIT, "./shaders/virtual_texture_frag.spv"},
+            },
+            .layout = pTexture->pipelineLayout,
+            .renderPass = pState->renderPass,
+            .cullMode = VK_CULL_MODE_NONE,
+            .frontFace = VK_FRONT_FACE_CLOCKWISE,
+            .depthWriteEnable = VK_TRUE,
+            .depthCompareOp = VK_COMPARE_OP_LESS,
+            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+    pTexture->pipeline = createGraphicsPipelineFromDesc(pState, &pipelineDesc);
+
+    // The coarsest mip is a single page that stays resident, every other page falls back to it.
+    uint32_t coarsestPage = VT_PAGE_COUNT - 1;
+    pageInVirtualTexture(pState, &coarsestPage, 1, 0);
+    waitForSubmitBatch(pState, &pTexture->uploadBatch);
+}
+
+// Runs once the previous frame is complete, so its feedback can be read. Also waits out the last page upload,
+// which normally finished before that frame even started.
+void updateVirtualTexture(AppState* pState) {
+    VirtualTextureResources* pTexture = &pState->virtualTexture;
+    if (pTexture->feedbackStamp == 0) {
+        return;
+    }
+
+    waitForSubmitBatch(pState, &pTexture->uploadBatch);
+
+    uint32_t pageIns[VT_MAX_PAGE_INS_PER_FRAME];
+    uint32_t pageInCount = processVirtualTextureFeedback(pTexture->pResidency, pTexture->pFeedback, pTexture->feedbackStamp,
+                                                         getTimeSeconds(), pageIns, VT_MAX_PAGE_INS_PER_FRAME);
+    pageInVirtualTexture(pState, pageIns, pageInCount, pTexture->feedbackStamp);
+}
+
+void recordVirtualTextureDraw(AppState* pState) {
+    VirtualTextureResources* pTexture = &pState->virtualTexture;
+    VkCommandBuffer commandBuffer = pState->commandBuffer;
+
+    VkViewport viewport = {
+            .x = 0.0f,
+            .y = 0.0f,
+            .width = (float) pState->renderExtent.width,
+            .height = (float) pState->renderExtent.height,
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+    };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    // Fly low over the plane on a fixed per frame path, so the visible set of pages keeps changing.
+    float t = (float) pState->run.frameCount / 60.0f;
+    Vec3 eye = {sinf(t * 0.1f) * 24.0f, 0.8f + 0.5f * sinf(t * 0.23f), cosf(t * 0.1f) * 24.0f};
+    Vec3 target = {sinf(t * 0.1f + 0.3f) * 20.0f, 0.0f, cosf(t * 0.1f + 0.3f) * 20.0f};
+    Mat4 view = mat4LookAt(eye, target, (Vec3) {0.0f, 1.0f, 0.0f});
+    Mat4 projection = mat4Perspective(1.0f, (float) pState->swapChainExtent.width / (float) pState->swapChainExtent.height, 0.05f, 100.0f);
+
+    pTexture->feedbackStamp = (uint32_t) pState->run.frameCount + 1;
+
+    VirtualTexturePushConstants pushConstants = {
+            .mvp = mat4Multiply(&projection, &view),
+            .feedbackStamp = pTexture->feedbackStamp,
+            .sparse = pTexture->sparse,
+    };
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pTexture->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pTexture->pipelineLayout, 0, 1, &pTexture->descriptorSet, 0, NULL);
+    vkCmdPushConstants(commandBuffer, pTexture->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+}
+
+void reportVirtualTextureStatistics(AppState* pState) {
+    VirtualTextureResources* pTexture = &pState->virtualTexture;
+    if (!pState->options.enableVirtualTexture || pState->run.frameCount == 0 || pState->run.frameCount % STATISTICS_REPORT_FRAMES != 0)
+        return;
+
+    VirtualTexture* pResidency = pTexture->pResidency;
+    VirtualTextureStats* pStats = &pResidency->stats;
+
+    uint32_t residentCount = 0;
+    for (uint32_t i = 0; i < VT_POOL_SLOT_COUNT; ++i) {
+        residentCount += pResidency->slotPages[i] >= 0;
+    }
+
+    printf("%s - frame %llu: hit rate %.1f%% of %llu page requests, %llu page-ins, %llu evictions, page-in latency avg %.2f ms max %.2f ms, %u/%u slots resident (%s)\n",
+           __FUNCTION__, (unsigned long long) pState->run.frameCount,
+           pStats->requestCount > 0 ? 100.0 * (double) pStats->hitCount / (double) pStats->requestCount : 100.0,
+           (unsigned long long) pStats->requestCount, (unsigned long long) pStats->pageInCount, (unsigned long long) pStats->evictionCount,
+           pStats->pageInCount > 0 ? pStats->totalLatency * 1000.0 / (double) pStats->pageInCount : 0.0, pStats->maxLatency * 1000.0,
+           residentCount, VT_POOL_SLOT_COUNT, pTexture->sparse ? "sparse" : "indirection");
+
+    memset(pStats, 0, sizeof(*pStats));
+}
+
+void destroyVirtualTexture(AppState* pState) {
+    VirtualTextureResources* pTexture = &pState->virtualTexture;
+
+    vkDestroyPipeline(pState->device, pTexture->pipeline, NULL);
+    vkDestroyPipelineLayout(pState->device, pTexture->pipelineLayout, NULL);
+    vkDestroyDescriptorSetLayout(pState->device, pTexture->setLayout, NULL);
+    vkDestroySemaphore(pState->device, pTexture->bindSemaphore, NULL);
+    vkFreeCommandBuffers(pState->device, pState->commandPool, 1, &pTexture->commandBuffer);
+
+    vkDestroySampler(pState->device, pTexture->nearestSampler, NULL);
+    vkDestroySampler(pState->device, pTexture->linearSampler, NULL);
+
+    vkDestroyBuffer(pState->device, pTexture->stagingBuffer, NULL);
+    vkFreeMemory(pState->device, pTexture->stagingMemory, NULL);
+    vkDestroyBuffer(pState->device, pTexture->feedbackBuffer, NULL);
+    vkFreeMemory(pState->device, pTexture->feedbackMemory, NULL);
+
+    vkDestroyImageView(pState->device, pTexture->pageTableImageView, NULL);
+    vkDestroyImage(pState->device, pTexture->pageTableImage, NULL);
+    vkFreeMemory(pState->device, pTexture->pageTableMemory, NULL);
+    vkDestroyImageView(pState->device, pTexture->physicalImageView, NULL);
+    vkDestroyImage(pState->device, pTexture->physicalImage, NULL);
+    vkFreeMemory(pState->device, pTexture->physicalMemory, NULL);
+
+    free(pTexture->pResidency);
+}
+
+void createQueryPools(AppState* pState) {
+    // Timestamps bracket the whole frame so triangle throughput can be compared between draw paths.
+    if (pState->timestampValidBits > 0 && pState->timestampPeriod > 0.0f) {
+        VkQueryPoolCreateInfo timestampPoolInfo = {
+                .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                .queryCount = TIMESTAMP_QUERY_COUNT,
+        };
+
+        if (vkCreateQueryPool(pState->device, &timestampPoolInfo, NULL, &pState->timestampQueryPool) != VK_SUCCESS) {
+            printf("%s - failed to create timestamp query pool!\n", __FUNCTION__);
+        }
+        recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_QUERY_POOL, VK_QUERY_TYPE_TIMESTAMP, TIMESTAMP_QUERY_COUNT, 0, NULL);
+    } else {
+        printf("%s - timestamps not supported on the graphics queue, GPU frame time disabled.\n", __FUNCTION__);
+        if (pState->options.enableDynamicResolution) {
+            printf("%s - dynamic resolution has no frame times to follow and stays at full resolution.\n", __FUNCTION__);
+        }
+    }
+
+    if (!pState->pipelineStatisticsSupported)
+        return;
+
+    // Results come back in bit order: vertex invocations, clipping primitives, fragment invocations.
+    VkQueryPoolCreateInfo queryPoolInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            .queryCount = 1,
+            .pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                  VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                  VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
+    };
+
+    if (vkCreateQueryPool(pState->device, &queryPoolInfo, NULL, &pState->statisticsQueryPool) != VK_SUCCESS) {
+        printf("%s - failed to create pipeline statistics query pool!\n", __FUNCTION__);
+        pState->pipelineStatisticsSupported = false;
+    }
+    recordManifestObject(&pState->run.manifest, MANIFEST_OBJECT_QUERY_POOL, VK_QUERY_TYPE_PIPELINE_STATISTICS, 1, queryPoolInfo.pipelineStatistics, NULL);
+}
+
+void createScene(AppState* pState) {
+    // A stack of overlapping triangles generated back to front, the worst case order for overdraw.
+    pState->sceneDrawCount = 32;
+    pState->pSceneDraws = malloc(sizeof(SceneDraw) * pState->sceneDrawCount);
+    pState->pSceneSortKeys = malloc(sizeof(uint64_t) * pState->sceneDrawCount);
+
+    for (uint32_t i = 0; i < pState->sceneDrawCount; ++i) {
+        SceneDraw draw = {
+                .x = (float) ((int) (i % 5) - 2) * 0.1f,
+                .y = (float) ((int) (i % 3) - 1) * 0.1f,
+                .scale = 1.5f - (float) i * 0.02f,
+                .depth = 0.95f - 0.9f * (float) i / (float) pState->sceneDrawCount,
+                .pipelineIndex = 0,
+        };
+        pState->pSceneDraws[i] = draw;
+    }
+}
+
+static int compareSortKeys(const void* pA, const void* pB) {
+    uint64_t a = *(const uint64_t*) pA;
+    uint64_t b = *(const uint64_t*) pB;
+    return (a > b) - (a < b);
+}
+
+void sortSceneDraws(AppState* pState) {
+    // Key layout, most significant first: pipeline (8 bits) | quantised depth (24 bits) | draw index (32 bits).
+    // Sorting ascending groups state changes and then orders each group front to back, which is what early-Z wants.
+    for (uint32_t i = 0; i < pState->sceneDrawCount; ++i) {
+        const SceneDraw* pDraw = &pState->pSceneDraws[i];
+        uint64_t depthBits = pState->options.enableFrontToBackSort ? (uint64_t) (pDraw->depth * (float) 0xFFFFFF) : 0;
+        pState->pSceneSortKeys[i] = ((uint64_t) (pDraw->pipelineIndex & 0xFF) << 56) | ((depthBits & 0xFFFFFF) << 32) | i;
+    }
+
+    qsort(pState->pSceneSortKeys, pState->sceneDrawCount, sizeof(uint64_t), compareSortKeys);
+}
+
+void recordSceneDraws(AppState* pState) {
+    const VkExtent2D extent = pState->renderExtent;
+
+    for (uint32_t i = 0; i < pState->sceneDrawCount; ++i) {
+        const SceneDraw* pDraw = &pState->pSceneDraws[pState->pSceneSortKeys[i] & 0xFFFFFFFF];
+
+        // The base triangle sits at z = 0, so a collapsed depth range places the whole draw at pDraw->depth.
+        float width = (float) extent.width * pDraw->scale;
+        float height = (float) extent.height * pDraw->scale;
+        VkViewport viewport = {
+                .x = (float) extent.width * (0.5f + 0.5f * pDraw->x) - width * 0.5f,
+                .y = (float) extent.height * (0.5f + 0.5f * pDraw->y) - height * 0.5f,
+                .width = width,
+                .height = height,
+                .minDepth = pDraw->depth,
+                .maxDepth = pDraw->depth,
+        };
+        vkCmdSetViewport(pState->commandBuffer, 0, 1, &viewport);
+
+        vkCmdDraw(pState->commandBuffer, 3, 1, 0, 0);
+    }
+}
+
+// GPU time between the timestamps of the last recorded frame, which must have finished.
+bool readFrameGpuMs(AppState* pState, double* pGpuMs) {
+    if (pState->timestampQueryPool == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    uint64_t timestamps[TIMESTAMP_QUERY_COUNT];
+    VkResult result = vkGetQueryPoolResults(pState->device, pState->timestampQueryPool, 0, TIMESTAMP_QUERY_COUNT, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return false;
+    }
+
+    uint64_t mask = pState->timestampValidBits >= 64 ? UINT64_MAX : (((uint64_t) 1 << pState->timestampValidBits) - 1);
+    *pGpuMs = (double) ((timestamps[1] - timestamps[0]) & mask) * pState->timestampPeriod * 1e-6;
+    return true;
+}
+
+// The statistics pool counts vertex shader invocations, which must not be queried around mesh shader draws.
+bool isPipelineStatisticsQueryAllowed(AppState* pState) {
+    return pState->pipelineStatisticsSupported && !(pState->mesh.indexCount > 0 && pState->meshletMode == MESHLET_MODE_MESH_SHADER);
+}
+
+// pGpuMs is the previous frame's GPU time as drawFrame already read it, or NULL when there is none.
+void reportPipelineStatistics(AppState* pState, const double* pGpuMs) {
+    if (pState->run.frameCount == 0 || pState->run.frameCount % STATISTICS_REPORT_FRAMES != 0)
+        return;
+
+    if (pState->lastFrameRecorded && pState->statisticsQueryRecorded) {
+        uint64_t statistics[3];
+        VkResult result = vkGetQueryPoolResults(pState->device, pState->statisticsQueryPool, 0, 1, sizeof(statistics), statistics, sizeof(statistics), VK_QUERY_RESULT_64_BIT);
+        if (result == VK_SUCCESS) {
+            // Overdraw here is fragment shader invocations per screen pixel.
+            double pixelCount = (double) pState->renderExtent.width * (double) pState->renderExtent.height;
+            printf("%s - frame %llu: vertex invocations %llu, primitives %llu, fragment invocations %llu, overdraw %.2fx (pre-pass %s, sort %s)\n",
+                   __FUNCTION__, (unsigned long long) pState->run.frameCount,
+                   (unsigned long long) statistics[0], (unsigned long long) statistics[1], (unsigned long long) statistics[2],
+                   (double) statistics[2] / pixelCount,
+                   pState->options.enableDepthPrePass ? "on" : "off", pState->options.enableFrontToBackSort ? "on" : "off");
+        }
+    }
+
+    if (pGpuMs != NULL) {
+        const double gpuMs = *pGpuMs;
+        // Submitted triangles, before any culling, so paths that cull more show higher throughput.
+        uint64_t triangleCount = pState->mesh.indexCount > 0 ? pState->mesh.indexCount / 3 : pState->sceneDrawCount * (pState->options.enableDepthPrePass ? 2 : 1);
+        printf("%s - frame %llu: gpu %.3f ms, %.0f triangles/ms (%s)\n",
+               __FUNCTION__, (unsigned long long) pState->run.frameCount, gpuMs,
+               gpuMs > 0.0 ? (double) triangleCount / gpuMs : 0.0,
+               pState->mesh.indexCount > 0 ? getMeshletModeName(pState->meshletMode) : "scene");
+    }
+}
+
+void reportDynamicResolution(AppState* pState) {
+    if (!pState->options.enableDynamicResolution || pState->run.frameCount == 0 || pState->run.frameCount % STATISTICS_REPORT_FRAMES != 0)
+        return;
+
+    DynamicResolution* pController = &pState->run.dynamicResolution;
+    const DynamicResolutionStats* pStats = &pController->stats;
+    if (pStats->frameCount > 0) {
+        printf("%s - frame %llu: render %ux%u (scale %.2f, range %.2f-%.2f), gpu avg %.3f ms, max %.3f ms, %u of %u frames over the %.2f ms budget\n",
+               __FUNCTION__, (unsigned long long) pState->run.frameCount, pState->renderExtent.width, pState->renderExtent.height,
+               pController->scale, pStats->minScale, pStats->maxScale, pStats->totalGpuMs / pStats->frameCount, pStats->maxGpuMs,
+               pStats->overBudgetCount, pStats->frameCount, pController->budgetMs);
+    }
+    resetDynamicResolutionStats(pController);
+}
+
+// Stands in for the swapchain when there is no window: one colour image in a fixed format so the bytes read back
+// are the same on every machine, plus a mapped buffer to read it into.
+void createHeadlessTarget(AppState* pState) {
+    pState->swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    pState->swapChainExtent = (VkExtent2D) {pState->options.screenWidth, pState->options.screenHeight};
+    pState->swapChainImageCount = 1;
+    pState->pSwapChainImages = malloc(sizeof(VkImage));
+
+    createImage(pState, pState->swapChainExtent.width, pState->swapChainExtent.height, 1, pState->swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &pState->pSwapChainImages[0], &pState->headlessImageMemory);
+
+    VkDeviceSize readbackSize = (VkDeviceSize) pState->swapChainExtent.width * pState->swapChainExtent.height * 4;
+    createBuffer(pState, readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &pState->readbackBuffer, &pState->readbackMemory);
+    vkMapMemory(pState->device, pState->readbackMemory, 0, readbackSize, 0, (void**) &pState->pReadbackData);
+}
+
+void destroyHeadlessTarget(AppState* pState) {
+    vkUnmapMemory(pState->device, pState->readbackMemory);
+    vkDestroyBuffer(pState->device, pState->readbackBuffer, NULL);
+    vkFreeMemory(pState->device, pState->readbackMemory, NULL);
+
+    vkDestroyImage(pState->device, pState->pSwapChainImages[0], NULL);
+    vkFreeMemory(pState->device, pState->headlessImageMemory, NULL);
+}
+
+// The render pass leaves the image in TRANSFER_SRC_OPTIMAL with its writes made available to transfers.
+void recordFrameReadback(AppState* pState, uint32_t imageIndex) {
+    VkBufferImageCopy copy = {
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+            .imageExtent = {pState->swapChainExtent.width, pState->swapChainExtent.height, 1},
+    };
+    vkCmdCopyImageToBuffer(pState->commandBuffer, pState->pSwapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           pState->readbackBuffer, 1, &copy);
+
+    VkMemoryBarrier hostBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier(pState->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, NULL, 0, NULL);
+}
+
+// Stretches the rendered corner of the offscreen target over the whole swapchain image with a linear blit. The
+// render pass leaves the target in TRANSFER_SRC_OPTIMAL; the swapchain image's previous contents are discarded.
+void recordUpscale(AppState* pState, uint32_t imageIndex) {
+    VkImageMemoryBarrier toTransfer = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = pState->pSwapChainImages[imageIndex],
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    // Chains with the acquire semaphore, which the submit waits for at the transfer stage.
+    vkCmdPipelineBarrier(pState->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &toTransfer);
+
+    VkImageBlit region = {
+            .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+            .srcOffsets = {{0, 0, 0}, {(int32_t) pState->renderExtent.width, (int32_t) pState->renderExtent.height, 1}},
+            .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+            .dstOffsets = {{0, 0, 0}, {(int32_t) pState->swapChainExtent.width, (int32_t) pState->swapChainExtent.height, 1}},
+    };
+    vkCmdBlitImage(pState->commandBuffer, pState->offscreenImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   pState->pSwapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+
+    VkImageMemoryBarrier toPresent = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = 0,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = pState->pSwapChainImages[imageIndex],
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(pState->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &toPresent);
+}
+
+void recordCommandBuffer(AppState* pState, uint32_t imageIndex) {
+    VkCommandBufferBeginInfo beginInfo = {
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO
+    };
+
+    if (vkBeginCommandBuffer(pState->commandBuffer, &beginInfo) != VK_SUCCESS) {
+        printf("%s - failed to begin recording command buffer!\n", __FUNCTION__);
+    }
+
+    if (pState->timestampQueryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(pState->commandBuffer, pState->timestampQueryPool, 0, TIMESTAMP_QUERY_COUNT);
+        vkCmdWriteTimestamp(pState->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pState->timestampQueryPool, 0);
+    }
+
+    // Only the frame whose results the next report prints pays for the query.
+    const bool recordStatistics = isPipelineStatisticsQueryAllowed(pState) && (pState->run.frameCount + 1) % STATISTICS_REPORT_FRAMES == 0;
+    pState->statisticsQueryRecorded = recordStatistics;
+    if (recordStatistics) {
+        vkCmdResetQueryPool(pState->commandBuffer, pState->statisticsQueryPool, 0, 1);
+        vkCmdBeginQuery(pState->commandBuffer, pState->statisticsQueryPool, 0, 0);
+    }
+
+    MeshletPushConstants meshPushConstants = {
+            .meshletCount = pState->mesh.meshletCount,
+    };
+    if (pState->mesh.indexCount > 0) {
+        Vec3 cameraPosition;
+        computeMeshTransform(pState, &meshPushConstants.mvp, &cameraPosition);
+        meshPushConstants.cameraPosition[0] = cameraPosition.x;
+        meshPushConstants.cameraPosition[1] = cameraPosition.y;
+        meshPushConstants.cameraPosition[2] = cameraPosition.z;
+
+        if (pState->meshletMode == MESHLET_MODE_COMPUTE_CULL) {
+            recordMeshletCull(pState, &meshPushConstants);
+        }
+    }
+
+    VkRenderPassBeginInfo renderPassInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .renderPass = pState->renderPass,
+            .framebuffer = pState->options.enableDynamicResolution ? pState->offscreenFramebuffer : pState->pSwapChainFramebuffers[imageIndex],
+            .renderArea.offset = {0, 0},
+            .renderArea.extent = pState->renderExtent,
+    };
+
+    VkClearValue clearValues[2] = {
+            {.color = {{0.0f, 0.0f, 0.0f, 1.0f}}},
+            {.depthStencil = {1.0f, 0}},
+    };
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
+
+    vkCmdBeginRenderPass(pState->commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
     VkRect2D scissor = {
             .offset = {0, 0},
-            .extent = pState->swapChainExtent,
+            .extent = pState->renderExtent,
     };
     vkCmdSetScissor(pState->commandBuffer, 0, 1, &scissor);
 
-    vkCmdDraw(pState->commandBuffer, 3, 1, 0, 0);
+    if (pState->mesh.indexCount > 0) {
+        recordMeshDraw(pState, &meshPushConstants);
+    } else if (pState->options.enableVirtualTexture) {
+        recordVirtualTextureDraw(pState);
+    } else {
+        if (pState->options.enableDepthPrePass) {
+            vkCmdBindPipeline(pState->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pState->depthPrePassPipeline);
+            recordSceneDraws(pState);
+        }
+
+        vkCmdBindPipeline(pState->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pState->graphicsPipeline);
+        recordSceneDraws(pState);
+    }
 
     vkCmdEndRenderPass(pState->commandBuffer);
 
+    if (pState->options.enableVirtualTexture) {
+        VkMemoryBarrier feedbackBarrier = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        };
+        vkCmdPipelineBarrier(pState->commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &feedbackBarrier, 0, NULL, 0, NULL);
+    }
+
+    if (pState->options.enableDynamicResolution) {
+        recordUpscale(pState, imageIndex);
+    }
+
+    if (recordStatistics) {
+        vkCmdEndQuery(pState->commandBuffer, pState->statisticsQueryPool, 0);
+    }
+
+    if (pState->timestampQueryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(pState->commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pState->timestampQueryPool, 1);
+    }
+
+    if (pState->run.captureFrame) {
+        recordFrameReadback(pState, imageIndex);
+    }
+
     if (vkEndCommandBuffer(pState->commandBuffer) != VK_SUCCESS) {
         printf("%s - failed to record command buffer!\n", __FUNCTION__);
     }
 }
 
+// The mesh turns and the virtual texture camera flies on a per frame path, the triangle scene stands still.
+bool isSceneAnimated(AppState* pState) {
+    return pState->mesh.indexCount > 0 || pState->options.enableVirtualTexture;
+}
+
 void drawFrame(AppState* pState) {
-    vkWaitForFences(pState->device, 1, &pState->inFlightFence, VK_TRUE, UINT64_MAX);
-    vkResetFences(pState->device, 1, &pState->inFlightFence);
+    // Also means the previous present has been issued, so the swapchain is free for the acquire.
+    waitForSubmitBatch(pState, &pState->frameBatch);
+
+    double gpuMs;
+    const bool gpuMsRead = pState->lastFrameRecorded && readFrameGpuMs(pState, &gpuMs);
+    if (gpuMsRead) {
+        pState->run.activity.gpuSeconds += gpuMs * 1e-3;
+        if (pState->options.enableDynamicResolution) {
+            updateDynamicResolution(&pState->run.dynamicResolution, pState->run.frameCount - 1, gpuMs, pState->renderExtent.width, pState->renderExtent.height);
+        }
+    }
 
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(pState->device, pState->swapChain, UINT64_MAX, pState->imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+    if (pState->options.injectDeviceLostInterval != 0 && pState->run.frameCount != 0 && pState->run.frameCount != pState->run.lastInjectedFrame &&
+        pState->run.frameCount % pState->options.injectDeviceLostInterval == 0) {
+        pState->run.lastInjectedFrame = pState->run.frameCount;
+        checkDeviceLost(pState, VK_ERROR_DEVICE_LOST, "fault injection");
+    }
+
+    // Nothing is recorded or submitted on a lost device, the caller rebuilds it before the next frame.
+    if (atomic_load(&pState->deviceLost)) {
+        return;
+    }
+
+    reportPipelineStatistics(pState, gpuMsRead ? &gpuMs : NULL);
+    reportDynamicResolution(pState);
+
+    pState->renderExtent = pState->swapChainExtent;
+    if (pState->options.enableDynamicResolution) {
+        getDynamicResolutionExtent(&pState->run.dynamicResolution, pState->swapChainExtent.width, pState->swapChainExtent.height,
+                                   &pState->renderExtent.width, &pState->renderExtent.height);
+    }
 
-    vkResetCommandBuffer(pState->commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
-    recordCommandBuffer(pState, imageIndex);
+    if (pState->options.enableVirtualTexture) {
+        updateVirtualTexture(pState);
+        reportVirtualTextureStatistics(pState);
+    }
+
+    uint32_t imageIndex = 0;
+    if (!pState->options.headless) {
+        VkResult result = vkAcquireNextImageKHR(pState->device, pState->swapChain, UINT64_MAX, pState->imageAvailableSemaphore,
+                                                VK_NULL_HANDLE, &imageIndex);
+        checkDeviceLost(pState, result, __FUNCTION__);
+        if (result == VK_ERROR_DEVICE_LOST) {
+            return;
+        }
+    }
+
+    // A presented image keeps its contents. When the acquired one already shows the current generation the frame
+    // records nothing and the batch only carries the semaphores from acquire to present.
+    const bool represent = pState->options.enableIdle && !pState->options.headless && !isSceneAnimated(pState) &&
+                           pState->pSwapChainImageGenerations[imageIndex] == pState->contentGeneration;
+
+    if (!represent) {
+        vkResetCommandBuffer(pState->commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
+        recordCommandBuffer(pState, imageIndex);
+        if (!pState->options.headless) {
+            pState->pSwapChainImageGenerations[imageIndex] = pState->contentGeneration;
+        }
+    }
+
+    SubmitBatch* pBatch = &pState->frameBatch;
+    pBatch->desc = (QueueSubmitDesc) {
+            .commandBufferCount = represent ? 0 : 1,
+            .pCommandBuffers = &pState->commandBuffer,
+            .binaryWaitSemaphore = pState->options.headless ? VK_NULL_HANDLE : pState->imageAvailableSemaphore,
+            .binaryWaitStageMask = represent ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+                    : pState->options.enableDynamicResolution ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .binarySignalSemaphore = pState->options.headless ? VK_NULL_HANDLE : pState->renderFinishedSemaphore,
+    };
+    pBatch->present = !pState->options.headless;
+    pBatch->imageIndex = imageIndex;
+    enqueueSubmitBatch(pState, pBatch);
+
+    pState->lastFrameRecorded = !represent;
+    pState->presentRequested = false;
+    pState->presentedGeneration = pState->contentGeneration;
+    if (represent) {
+        pState->run.activity.representedFrames++;
+    } else {
+        pState->run.activity.renderedFrames++;
+    }
+    pState->run.frameCount++;
+}
+
+// Renders the normal frame plus three empty batches standing in for upload, compute and readback producers, once
+// submitting each batch on the spot and once through the submit thread. Prints submit calls and CPU time per frame.
+void benchmarkSubmission(AppState* pState) {
+    const uint32_t frameCount = 600;
+    const uint32_t extraBatchCount = 3;
+
+    VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pState->commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = extraBatchCount,
+    };
+    VkCommandBuffer commandBuffers[extraBatchCount];
+    vkAllocateCommandBuffers(pState->device, &allocInfo, commandBuffers);
 
-    VkSubmitInfo submitInfo = {
-            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO
+    VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
     };
+    for (uint32_t i = 0; i < extraBatchCount; ++i) {
+        vkBeginCommandBuffer(commandBuffers[i], &beginInfo);
+        vkEndCommandBuffer(commandBuffers[i]);
+    }
+
+    SubmitBatch extraBatches[extraBatchCount];
+    memset(extraBatches, 0, sizeof(extraBatches));
+
+    const bool submitThreadEnabled = pState->options.enableSubmitThread;
+    for (int threaded = 0; threaded < 2; ++threaded) {
+        pState->options.enableSubmitThread = threaded;
+        startSubmitThread(pState);
+        if (threaded && pState->submitQueue.pThread == NULL) {
+            break;
+        }
+
+        SubmitQueue* pSubmit = &pState->submitQueue;
+        uint64_t submitCalls = pSubmit->submitCallCount;
+        uint64_t batches = pSubmit->batchCount;
+        double cpuStart = getThreadCpuSeconds();
+        double start = getTimeSeconds();
+
+        for (uint32_t frame = 0; frame < frameCount && !glfwWindowShouldClose(pState->run.pWindow); ++frame) {
+            glfwPollEvents();
+
+            for (uint32_t i = 0; i < extraBatchCount; ++i) {
+                waitForSubmitBatch(pState, &extraBatches[i]);
+                extraBatches[i].desc = (QueueSubmitDesc) {
+                        .commandBufferCount = 1,
+                        .pCommandBuffers = &commandBuffers[i],
+                };
+                enqueueSubmitBatch(pState, &extraBatches[i]);
+            }
+
+            drawFrame(pState);
+        }
+
+        double cpuSeconds = getThreadCpuSeconds() - cpuStart;
+        double seconds = getTimeSeconds() - start;
+        stopSubmitThread(pState);
+        for (uint32_t i = 0; i < extraBatchCount; ++i) {
+            waitForSubmitBatch(pState, &extraBatches[i]);
+        }
+        waitForSubmitBatch(pState, &pState->frameBatch);
+
+        submitCalls = pSubmit->submitCallCount - submitCalls;
+        batches = pSubmit->batchCount - batches;
+        printf("%s - %s: %.2f submit calls/frame for %.2f batches/frame, %.3f ms/frame, frame thread CPU %.3f ms/frame",
+               __FUNCTION__, threaded ? "submit thread" : "direct", (double) submitCalls / frameCount,
+               (double) batches / frameCount, seconds * 1000.0 / frameCount, cpuSeconds * 1000.0 / frameCount);
+        if (threaded) {
+            printf(", submit thread CPU %.3f ms/frame", pSubmit->threadCpuSeconds * 1000.0 / frameCount);
+        }
+        printf("\n");
+    }
+    pState->options.enableSubmitThread = submitThreadEnabled;
 
-    VkSemaphore waitSemaphores[] = {pState->imageAvailableSemaphore};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    vkFreeCommandBuffers(pState->device, pState->commandPool, extraBatchCount, commandBuffers);
+}
 
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &pState->commandBuffer;
+// Records the scene's viewport + draw pair many times into the frame command buffer, once through the loader
+// trampolines that linking against the loader gives, once through the dispatch table, and prints the CPU cost per
+// call of each. Nothing is submitted. Run with --no-validation, otherwise both paths mostly measure the layer.
+void benchmarkDrawCalls(AppState* pState) {
+    const uint32_t drawCount = 100000;
+    const uint32_t repeatCount = 10;
 
-    VkSemaphore signalSemaphores[] = {pState->renderFinishedSemaphore};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    // For device functions vkGetInstanceProcAddr hands out the same trampolines the loader exports.
+    PFN_vkCmdSetViewport trampolineSetViewport = (PFN_vkCmdSetViewport) vkGetInstanceProcAddr(pState->instance, "vkCmdSetViewport");
+    PFN_vkCmdDraw trampolineDraw = (PFN_vkCmdDraw) vkGetInstanceProcAddr(pState->instance, "vkCmdDraw");
 
-    if (vkQueueSubmit(pState->queue, 1, &submitInfo, pState->inFlightFence) != VK_SUCCESS) {
-        printf("%s - failed to submit draw command buffer!\n", __FUNCTION__);
+    if (pState->options.enableValidationLayers) {
+        printf("%s - validation layers are enabled, both paths go through them!\n", __FUNCTION__);
     }
 
-    VkPresentInfoKHR presentInfo = {
-            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR
+    VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VkRenderPassBeginInfo renderPassInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .renderPass = pState->renderPass,
+            .framebuffer = pState->pSwapChainFramebuffers[0],
+            .renderArea.extent = pState->swapChainExtent,
+    };
+    VkViewport viewport = {
+            .width = (float) pState->swapChainExtent.width,
+            .height = (float) pState->swapChainExtent.height,
+            .maxDepth = 1.0f,
     };
 
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    double bestSeconds[2] = {1e9, 1e9};
+    for (uint32_t repeat = 0; repeat < repeatCount; ++repeat) {
+        for (int direct = 0; direct < 2; ++direct) {
+            PFN_vkCmdSetViewport cmdSetViewport = direct ? vkCmdSetViewport : trampolineSetViewport;
+            PFN_vkCmdDraw cmdDraw = direct ? vkCmdDraw : trampolineDraw;
+
+            vkResetCommandBuffer(pState->commandBuffer, 0);
+            vkBeginCommandBuffer(pState->commandBuffer, &beginInfo);
+            vkCmdBeginRenderPass(pState->commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBindPipeline(pState->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pState->graphicsPipeline);
+
+            double start = getTimeSeconds();
+            for (uint32_t i = 0; i < drawCount; ++i) {
+                cmdSetViewport(pState->commandBuffer, 0, 1, &viewport);
+                cmdDraw(pState->commandBuffer, 3, 1, 0, 0);
+            }
+            double seconds = getTimeSeconds() - start;
+            if (seconds < bestSeconds[direct]) {
+                bestSeconds[direct] = seconds;
+            }
+
+            vkCmdEndRenderPass(pState->commandBuffer);
+            vkEndCommandBuffer(pState->commandBuffer);
+        }
+    }
+    vkResetCommandBuffer(pState->commandBuffer, 0);
 
-    VkSwapchainKHR swapChains[] = {pState->swapChain};
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
+    const uint32_t callCount = drawCount * 2;
+    printf("%s - loader trampolines %.2f ns/call, dispatch table %.2f ns/call, %u calls, best of %u\n", __FUNCTION__,
+           bestSeconds[0] * 1e9 / callCount, bestSeconds[1] * 1e9 / callCount, callCount, repeatCount);
+}
 
-    presentInfo.pImageIndices = &imageIndex;
+// Each step is recorded in the manifest with the objects it created, so a rebuild replays the same steps in order.
+typedef enum InitStep {
+    INIT_STEP_INSTANCE,
+    INIT_STEP_DEBUG_MESSENGER,
+    INIT_STEP_SURFACE,
+    INIT_STEP_DEVICE,
+    INIT_STEP_SWAPCHAIN,
+    INIT_STEP_HEADLESS_TARGET,
+    INIT_STEP_IMAGE_VIEWS,
+    INIT_STEP_DEPTH,
+    INIT_STEP_OFFSCREEN_TARGET,
+    INIT_STEP_RENDER_PASS,
+    INIT_STEP_PIPELINE_CACHE,
+    INIT_STEP_GRAPHICS_PIPELINE,
+    INIT_STEP_FRAMEBUFFERS,
+    INIT_STEP_COMMAND_POOL,
+    INIT_STEP_COMMAND_BUFFER,
+    INIT_STEP_SYNC,
+    INIT_STEP_QUERY_POOLS,
+    INIT_STEP_DESCRIPTOR_POOL,
+    INIT_STEP_UPLOAD_CONTEXT,
+    INIT_STEP_SCENE,
+    INIT_STEP_VIRTUAL_TEXTURE,
+    INIT_STEP_MESH,
+    INIT_STEP_MESHLETS,
+} InitStep;
+
+void runInitStep(AppState* pState, InitStep step) {
+    beginManifestStep(&pState->run.manifest, step);
+    double start = getTimeSeconds();
+
+    switch (step) {
+        case INIT_STEP_INSTANCE:
+            createInstance(pState);
+            break;
+        case INIT_STEP_DEBUG_MESSENGER:
+            setupDebugMessenger(pState);
+            break;
+        case INIT_STEP_SURFACE:
+            createSurface(pState);
+            break;
+        case INIT_STEP_DEVICE:
+            pickPhysicalDevice(pState);
+            createLogicalDevice(pState);
+            break;
+        case INIT_STEP_SWAPCHAIN:
+            createSwapChain(pState);
+            break;
+        case INIT_STEP_HEADLESS_TARGET:
+            createHeadlessTarget(pState);
+            break;
+        case INIT_STEP_IMAGE_VIEWS:
+            createImageViews(pState);
+            break;
+        case INIT_STEP_DEPTH:
+            createDepthResources(pState);
+            break;
+        case INIT_STEP_OFFSCREEN_TARGET:
+            createOffscreenTarget(pState);
+            break;
+        case INIT_STEP_RENDER_PASS:
+            createRenderPass(pState);
+            break;
+        case INIT_STEP_PIPELINE_CACHE:
+            createPipelineCache(pState);
+            break;
+        case INIT_STEP_GRAPHICS_PIPELINE:
+            createGraphicsPipeline(pState);
+            break;
+        case INIT_STEP_FRAMEBUFFERS:
+            createFramebuffers(pState);
+            break;
+        case INIT_STEP_COMMAND_POOL:
+            createCommandPool(pState);
+            break;
+        case INIT_STEP_COMMAND_BUFFER:
+            createCommandBuffer(pState);
+            break;
+        case INIT_STEP_SYNC:
+            createSyncObjects(pState);
+            break;
+        case INIT_STEP_QUERY_POOLS:
+            createQueryPools(pState);
+            break;
+        case INIT_STEP_DESCRIPTOR_POOL:
+            createDescriptorPool(pState);
+            break;
+        case INIT_STEP_UPLOAD_CONTEXT:
+            createUploadContext(pState);
+            break;
+        case INIT_STEP_SCENE:
+            createScene(pState);
+            sortSceneDraws(pState);
+            break;
+        case INIT_STEP_VIRTUAL_TEXTURE:
+            createVirtualTexture(pState);
+            break;
+        case INIT_STEP_MESH:
+            if (loadMesh(pState, pState->options.meshFilename, &pState->mesh)) {
+                createMeshPipeline(pState);
+            }
+            break;
+        case INIT_STEP_MESHLETS:
+            createMeshletPipelines(pState);
+            break;
+    }
 
-    vkQueuePresentKHR(pState->queue, &presentInfo);
+    endManifestStep(&pState->run.manifest, getTimeSeconds() - start);
 }
 
 void initVulkan(AppState* pState) {
     printf( "%s - initializing vulkan!\n", __FUNCTION__ );
-    createInstance(pState);
-    setupDebugMessenger(pState);
-    createSurface(pState);
-    pickPhysicalDevice(pState);
-    createLogicalDevice(pState);
-    createSwapChain(pState);
-    createImageViews(pState);
-    createRenderPass(pState);
-    createGraphicsPipeline(pState);
-    createFramebuffers(pState);
-    createCommandPool(pState);
-    createCommandBuffer(pState);
-    createSyncObjects(pState);
-}
-
-void mainLoop(AppState* pState) {
-    printf( "%s - app mainloop starting!\n", __FUNCTION__ );
+    runInitStep(pState, INIT_STEP_INSTANCE);
+    runInitStep(pState, INIT_STEP_DEBUG_MESSENGER);
+    if (!pState->options.headless) {
+        runInitStep(pState, INIT_STEP_SURFACE);
+    }
+    runInitStep(pState, INIT_STEP_DEVICE);
+    runInitStep(pState, pState->options.headless ? INIT_STEP_HEADLESS_TARGET : INIT_STEP_SWAPCHAIN);
+    runInitStep(pState, INIT_STEP_IMAGE_VIEWS);
+    runInitStep(pState, INIT_STEP_DEPTH);
+    if (pState->options.enableDynamicResolution) {
+        runInitStep(pState, INIT_STEP_OFFSCREEN_TARGET);
+    }
+    runInitStep(pState, INIT_STEP_RENDER_PASS);
+    runInitStep(pState, INIT_STEP_PIPELINE_CACHE);
+    runInitStep(pState, INIT_STEP_GRAPHICS_PIPELINE);
+    runInitStep(pState, INIT_STEP_FRAMEBUFFERS);
+    runInitStep(pState, INIT_STEP_COMMAND_POOL);
+    runInitStep(pState, INIT_STEP_COMMAND_BUFFER);
+    runInitStep(pState, INIT_STEP_SYNC);
+    runInitStep(pState, INIT_STEP_QUERY_POOLS);
+    runInitStep(pState, INIT_STEP_DESCRIPTOR_POOL);
+    runInitStep(pState, INIT_STEP_UPLOAD_CONTEXT);
+    runInitStep(pState, INIT_STEP_SCENE);
+
+    if (pState->options.enableVirtualTexture) {
+        runInitStep(pState, INIT_STEP_VIRTUAL_TEXTURE);
+    }
 
-    while (!glfwWindowShouldClose(pState->pWindow)) {
-        glfwPollEvents();
-        drawFrame(pState);
+    if (pState->options.meshFilename != NULL) {
+        runInitStep(pState, INIT_STEP_MESH);
+        if (pState->meshPipeline != VK_NULL_HANDLE && pState->options.enableMeshlets) {
+            runInitStep(pState, INIT_STEP_MESHLETS);
+        }
     }
 
-    vkDeviceWaitIdle(pState->device);
+    savePipelineCache(pState);
 }
 
-void cleanup(AppState* pState) {
-    printf("%s - cleaning up app!\n", __FUNCTION__);
+// Destroys everything initVulkan created, down to the instance. Also valid on a lost device: destroying objects is
+// allowed there and the waits return instead of blocking.
+void destroyVulkan(AppState* pState) {
+    if (!atomic_load(&pState->deviceLost)) {
+        savePipelineCache(pState);
+    }
 
     vkDestroySemaphore(pState->device, pState->renderFinishedSemaphore, NULL);
     vkDestroySemaphore(pState->device, pState->imageAvailableSemaphore, NULL);
-    vkDestroyFence(pState->device, pState->inFlightFence, NULL);
+    destroyQueueTimeline(pState, &pState->graphicsTimeline);
+
+    if (pState->pipelineStatisticsSupported) {
+        vkDestroyQueryPool(pState->device, pState->statisticsQueryPool, NULL);
+    }
+    vkDestroyQueryPool(pState->device, pState->timestampQueryPool, NULL);
+
+    free(pState->pSceneSortKeys);
+    free(pState->pSceneDraws);
+
+    if (pState->meshPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(pState->device, pState->meshPipeline, NULL);
+        vkDestroyPipelineLayout(pState->device, pState->meshPipelineLayout, NULL);
+        destroyGpuMesh(pState, &pState->mesh);
+    }
+
+    if (pState->meshletPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipeline(pState->device, pState->meshletCullPipeline, NULL);
+        vkDestroyPipeline(pState->device, pState->meshletMeshShaderPipeline, NULL);
+        vkDestroyPipelineLayout(pState->device, pState->meshletPipelineLayout, NULL);
+        vkDestroyDescriptorSetLayout(pState->device, pState->meshletSetLayout, NULL);
+    }
+
+    if (pState->meshDecodePipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(pState->device, pState->meshDecodePipeline, NULL);
+        vkDestroyPipelineLayout(pState->device, pState->meshDecodePipelineLayout, NULL);
+        vkDestroyDescriptorSetLayout(pState->device, pState->meshDecodeSetLayout, NULL);
+    }
+
+    if (pState->options.enableVirtualTexture) {
+        destroyVirtualTexture(pState);
+    }
+
+    destroyUploadContext(pState);
+    vkDestroyDescriptorPool(pState->device, pState->descriptorPool, NULL);
 
     vkDestroyCommandPool(pState->device, pState->commandPool, NULL);
 
@@ -896,26 +4232,329 @@ void cleanup(AppState* pState) {
     }
 
     vkDestroyPipeline(pState->device, pState->graphicsPipeline, NULL);
+    if (pState->options.enableDepthPrePass) {
+        vkDestroyPipeline(pState->device, pState->depthPrePassPipeline, NULL);
+    }
     vkDestroyPipelineLayout(pState->device, pState->pipelineLayout, NULL);
     vkDestroyRenderPass(pState->device, pState->renderPass, NULL);
+    vkDestroyPipelineCache(pState->device, pState->pipelineCache, NULL);
 
     for (int i = 0; i < pState->swapChainImageCount; ++i) {
         vkDestroyImageView(pState->device, pState->pSwapChainImageViews[i], NULL);
     }
 
-    vkDestroySwapchainKHR(pState->device, pState->swapChain, NULL);
+    vkDestroyImageView(pState->device, pState->depthImageView, NULL);
+    vkDestroyImage(pState->device, pState->depthImage, NULL);
+    vkFreeMemory(pState->device, pState->depthImageMemory, NULL);
+
+    if (pState->options.enableDynamicResolution) {
+        destroyOffscreenTarget(pState);
+    }
+
+    if (pState->options.headless) {
+        destroyHeadlessTarget(pState);
+    } else {
+        vkDestroySwapchainKHR(pState->device, pState->swapChain, NULL);
+    }
+    free(pState->pSwapChainFramebuffers);
+    free(pState->pSwapChainImageViews);
+    free(pState->pSwapChainImages);
+    free(pState->pSwapChainImageGenerations);
     vkDestroyDevice(pState->device, NULL);
 
-    if (pState->enableValidationLayers) {
+    if (pState->options.enableValidationLayers) {
         DestroyDebugUtilsMessengerEXT(pState->instance, pState->debugMessenger, NULL);
     }
 
-    vkDestroySurfaceKHR(pState->instance, pState->surface, NULL);
+    if (!pState->options.headless) {
+        vkDestroySurfaceKHR(pState->instance, pState->surface, NULL);
+    }
     vkDestroyInstance(pState->instance, NULL);
+}
+
+// Zeroes the device-owned part of the state, everything destroyVulkan released, so the init functions start from the
+// same state as on startup. The options and the run state sit in front of it and are not touched.
+void resetDeviceState(AppState* pState) {
+    memset(&pState->instance, 0, sizeof(AppState) - offsetof(AppState, instance));
+}
+
+// Tears the lost device down to the instance and replays the manifest's init steps, so the rebuild creates exactly
+// the objects of the first init; pipelines come out of the cache saved then. Prints teardown, rebuild and time to the
+// first finished frame. Must be called from the frame loop, with no frame of its own in flight.
+bool recoverFromDeviceLoss(AppState* pState) {
+    const double lostTime = getTimeSeconds();
+    const bool submitThreadRunning = pState->submitQueue.pThread != NULL;
+    stopSubmitThread(pState);
+
+    vkDeviceWaitIdle(pState->device);
+    destroyVulkan(pState);
+    const double destroyedTime = getTimeSeconds();
+
+    ResourceManifest expected = pState->run.manifest;
+    initResourceManifest(&pState->run.manifest);
+    resetDeviceState(pState);
+
+    printf("%s - rebuilding %u objects in %u steps\n", __FUNCTION__, expected.objectCount, expected.stepCount);
+    for (uint32_t i = 0; i < expected.stepCount; ++i) {
+        runInitStep(pState, expected.steps[i]);
+    }
+    const double rebuiltTime = getTimeSeconds();
+
+    uint32_t mismatch = findManifestMismatch(&expected, &pState->run.manifest);
+    if (mismatch != UINT32_MAX) {
+        const ManifestObject* pObject = mismatch < expected.objectCount ? &expected.pObjects[mismatch] : NULL;
+        printf("%s - rebuild differs from the first init at object %u (%s)!\n", __FUNCTION__, mismatch,
+               pObject != NULL ? getManifestObjectTypeName(pObject->type) : "extra object");
+    }
+    destroyResourceManifest(&expected);
+
+    if (submitThreadRunning) {
+        startSubmitThread(pState);
+    }
+
+    drawFrame(pState);
+    waitForSubmitBatch(pState, &pState->frameBatch);
+    const double firstFrameTime = getTimeSeconds();
+
+    if (atomic_load(&pState->deviceLost)) {
+        printf("%s - device lost again during recovery!\n", __FUNCTION__);
+        return false;
+    }
+
+    pState->run.recoveryCount++;
+    uint32_t counts[MANIFEST_OBJECT_TYPE_COUNT];
+    countManifestObjects(&pState->run.manifest, counts);
+    printf("%s - recovery %u: teardown %.2f ms, rebuild %.2f ms, first frame %.2f ms after the loss (%u pipelines, %u images, %u buffers, %u memory allocations, %u command buffers, %u descriptor sets)\n",
+           __FUNCTION__, pState->run.recoveryCount, (destroyedTime - lostTime) * 1000.0, (rebuiltTime - destroyedTime) * 1000.0,
+           (firstFrameTime - lostTime) * 1000.0, counts[MANIFEST_OBJECT_PIPELINE], counts[MANIFEST_OBJECT_IMAGE],
+           counts[MANIFEST_OBJECT_BUFFER], counts[MANIFEST_OBJECT_MEMORY], counts[MANIFEST_OBJECT_COMMAND_BUFFER],
+           counts[MANIFEST_OBJECT_DESCRIPTOR_SET]);
+    return true;
+}
+
+// Checks one captured frame against its golden image. The hash decides in the common case; when it differs the
+// golden PPM is compared pixel by pixel and the actual frame is written next to it for inspection.
+static bool checkReferenceFrame(AppState* pState, uint32_t captureIndex, uint64_t hash, uint64_t expectedHash) {
+    const uint32_t width = pState->swapChainExtent.width;
+    const uint32_t height = pState->swapChainExtent.height;
+    const uint32_t frame = referenceCaptureFrames[captureIndex];
+
+    if (hash == expectedHash) {
+        return true;
+    }
+
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s/frame_%u.ppm", pState->options.referenceDirectory, frame);
+
+    uint32_t goldenWidth, goldenHeight;
+    uint8_t* pGolden = readPpm(filename, &goldenWidth, &goldenHeight);
+    bool passed = false;
+    if (pGolden != NULL && goldenWidth == width && goldenHeight == height) {
+        uint32_t differing = countDifferingPixels(pState->pReadbackData, pGolden, width * height, REFERENCE_CHANNEL_TOLERANCE);
+        passed = differing <= (uint32_t) (REFERENCE_PIXEL_TOLERANCE * width * height);
+        printf("%s - frame %u hash %016llx differs from %016llx, %u pixels outside tolerance\n", __FUNCTION__, frame,
+               (unsigned long long) hash, (unsigned long long) expectedHash, differing);
+    } else {
+        printf("%s - frame %u has no usable golden image!\n", __FUNCTION__, frame);
+    }
+    free(pGolden);
+
+    if (!passed) {
+        snprintf(filename, sizeof(filename), "%s/frame_%u_actual.ppm", pState->options.referenceDirectory, frame);
+        writePpm(filename, pState->pReadbackData, width, height);
+    }
+    return passed;
+}
+
+// Renders a fixed sequence of frames headless, hashes the captured ones and times every frame after warm up. When
+// recording, the hashes, golden images and frame-time baseline are written to the reference directory; otherwise
+// they are compared against it. Returns false on any image mismatch or a median frame time more than
+// frameTimeTolerance above the baseline.
+bool runReference(AppState* pState) {
+    const uint32_t width = pState->swapChainExtent.width;
+    const uint32_t height = pState->swapChainExtent.height;
+
+    char baselineFilename[1024];
+    snprintf(baselineFilename, sizeof(baselineFilename), "%s/baseline.txt", pState->options.referenceDirectory);
+
+    ReferenceBaseline expected;
+    if (!pState->options.recordReference) {
+        if (!readReferenceBaseline(baselineFilename, &expected)) {
+            return false;
+        }
+        if (expected.width != width || expected.height != height) {
+            printf("%s - baseline is %ux%u, this run renders %ux%u!\n", __FUNCTION__, expected.width, expected.height, width, height);
+            return false;
+        }
+    }
+
+    ReferenceBaseline actual = {
+            .width = width,
+            .height = height,
+    };
+    double frameMs[REFERENCE_FRAME_COUNT];
+    uint32_t timedFrameCount = 0;
+    uint32_t captureIndex = 0;
+    bool passed = true;
+
+    for (uint32_t frame = 0; frame < REFERENCE_FRAME_COUNT; ++frame) {
+        pState->run.captureFrame = captureIndex < REFERENCE_CAPTURE_COUNT && referenceCaptureFrames[captureIndex] == frame;
+
+        double start = getTimeSeconds();
+        drawFrame(pState);
+        waitForSubmitBatch(pState, &pState->frameBatch);
+
+        // Recovery renders the lost frame again on the rebuilt device. It is checked as usual but not timed.
+        bool recovered = false;
+        if (atomic_load(&pState->deviceLost)) {
+            if (!recoverFromDeviceLoss(pState)) {
+                return false;
+            }
+            recovered = true;
+        }
+
+        if (frame >= REFERENCE_FIRST_TIMED_FRAME && !pState->run.captureFrame && !recovered) {
+            frameMs[timedFrameCount++] = (getTimeSeconds() - start) * 1000.0;
+        }
+
+        if (!pState->run.captureFrame) {
+            continue;
+        }
+
+        uint64_t hash = hashImage(pState->pReadbackData, width, height);
+        actual.frameHashes[captureIndex] = hash;
+
+        if (pState->options.recordReference) {
+            char filename[1024];
+            snprintf(filename, sizeof(filename), "%s/frame_%u.ppm", pState->options.referenceDirectory, frame);
+            passed &= writePpm(filename, pState->pReadbackData, width, height);
+        } else if (!checkReferenceFrame(pState, captureIndex, hash, expected.frameHashes[captureIndex])) {
+            printf("%s - frame %u does not match the reference!\n", __FUNCTION__, frame);
+            passed = false;
+        }
+        captureIndex++;
+    }
+    pState->run.captureFrame = false;
+
+    // With fault injection the run only proves something if the device was actually rebuilt and every captured frame
+    // was still checked afterwards.
+    if (captureIndex != REFERENCE_CAPTURE_COUNT) {
+        printf("%s - only %u of %u frames were captured!\n", __FUNCTION__, captureIndex, REFERENCE_CAPTURE_COUNT);
+        passed = false;
+    }
+    if (pState->options.injectDeviceLostInterval != 0) {
+        printf("%s - recovered from %u device losses\n", __FUNCTION__, pState->run.recoveryCount);
+        if (pState->run.recoveryCount == 0) {
+            printf("%s - device loss was injected but never recovered from!\n", __FUNCTION__);
+            passed = false;
+        }
+    }
+
+    computeFrameTimePercentiles(frameMs, timedFrameCount, &actual.medianFrameMs, &actual.p95FrameMs);
+
+    if (pState->options.recordReference) {
+        passed &= writeReferenceBaseline(baselineFilename, &actual);
+        printf("%s - recorded %u frames, median %.3f ms, p95 %.3f ms\n", __FUNCTION__, REFERENCE_FRAME_COUNT, actual.medianFrameMs, actual.p95FrameMs);
+        return passed;
+    }
+
+    double limitMs = expected.medianFrameMs * (1.0 + pState->options.frameTimeTolerance);
+    printf("%s - median %.3f ms (baseline %.3f ms, limit %.3f ms), p95 %.3f ms (baseline %.3f ms)\n", __FUNCTION__,
+           actual.medianFrameMs, expected.medianFrameMs, limitMs, actual.p95FrameMs, expected.p95FrameMs);
+    if (actual.medianFrameMs > limitMs) {
+        printf("%s - frame time regressed by more than %.0f%%!\n", __FUNCTION__, pState->options.frameTimeTolerance * 100.0);
+        passed = false;
+    }
+
+    printf("%s - %s\n", __FUNCTION__, passed ? "passed" : "FAILED");
+    return passed;
+}
+
+// Always with idle mode off. Otherwise when the scene moves by itself, when something changed since the last
+// present, or when the window system asked for the contents again, and never while the window is minimised.
+bool isFrameDue(AppState* pState) {
+    if (!pState->options.enableIdle) {
+        return true;
+    }
+    if (pState->run.windowIconified) {
+        return false;
+    }
+    return isSceneAnimated(pState) || pState->presentRequested || pState->presentedGeneration != pState->contentGeneration;
+}
+
+// CPU is the whole process including the submit thread, in percent of one core. GPU is the summed timestamp span of
+// the rendered frames over wall time.
+void reportUtilisation(AppState* pState) {
+    FrameActivity* pActivity = &pState->run.activity;
+    const double now = getTimeSeconds();
+
+    if (pActivity->startTime == 0.0 || now - pActivity->startTime >= UTILISATION_REPORT_SECONDS) {
+        if (pActivity->startTime != 0.0) {
+            const double seconds = now - pActivity->startTime;
+            printf("%s - %s scene, idle %s: %.1f rendered and %.1f re-presented frames/s, CPU %.1f%% of a core",
+                   __FUNCTION__, isSceneAnimated(pState) ? "animated" : "static", pState->options.enableIdle ? "on" : "off",
+                   pActivity->renderedFrames / seconds, pActivity->representedFrames / seconds,
+                   (getProcessCpuSeconds() - pActivity->startCpuSeconds) * 100.0 / seconds);
+            if (pState->timestampQueryPool != VK_NULL_HANDLE) {
+                printf(", GPU %.1f%%", pActivity->gpuSeconds * 100.0 / seconds);
+            }
+            printf("\n");
+        }
+
+        *pActivity = (FrameActivity) {
+                .startTime = now,
+                .startCpuSeconds = getProcessCpuSeconds(),
+        };
+    }
+}
+
+void mainLoop(AppState* pState) {
+    printf( "%s - app mainloop starting!\n", __FUNCTION__ );
+
+    startSubmitThread(pState);
+
+    bool firstFrame = true;
+    pState->presentRequested = true;
+    while (!glfwWindowShouldClose(pState->run.pWindow)) {
+        if (isFrameDue(pState)) {
+            glfwPollEvents();
+        } else {
+            glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT_SECONDS);
+        }
+        reportUtilisation(pState);
+
+        if (!isFrameDue(pState)) {
+            continue;
+        }
+        drawFrame(pState);
+
+        if (firstFrame) {
+            printf("%s - first frame submitted %.2f ms after startup\n", __FUNCTION__, (getTimeSeconds() - pState->run.startTime) * 1000.0);
+            firstFrame = false;
+        }
+        if (atomic_load(&pState->deviceLost) && !recoverFromDeviceLoss(pState)) {
+            break;
+        }
+    }
+
+    stopSubmitThread(pState);
+    vkDeviceWaitIdle(pState->device);
+}
+
+void cleanup(AppState* pState) {
+    printf("%s - cleaning up app!\n", __FUNCTION__);
 
-    glfwDestroyWindow(pState->pWindow);
+    destroyVulkan(pState);
+    destroyResourceManifest(&pState->run.manifest);
+    free(pState->run.pPipelineCacheData);
+    if (pState->run.dynamicResolution.pTraceFile != NULL) {
+        fclose(pState->run.dynamicResolution.pTraceFile);
+    }
 
-    glfwTerminate();
+    if (!pState->options.headless) {
+        glfwDestroyWindow(pState->run.pWindow);
+        glfwTerminate();
+    }
 }
 
 
@@ -926,17 +4565,123 @@ int main(int argc, char *argv[])
     AppState *pState;
     pState = malloc(sizeof(*pState));
     memset(pState, 0, sizeof( *pState ) );
-    pState->screenWidth = 800;
-    pState->screenHeight = 600;
-    pState->enableValidationLayers = true;
+    pState->options.screenWidth = 800;
+    pState->options.screenHeight = 600;
+    pState->options.enableValidationLayers = true;
+    pState->options.enableDepthPrePass = true;
+    pState->options.enableFrontToBackSort = true;
+    pState->options.enableMeshShader = true;
+    pState->options.enableSparseResidency = true;
+    pState->options.enableTimelineSemaphore = true;
+    pState->options.enableSubmitThread = true;
+    pState->options.enableIdle = true;
+    pState->options.frameTimeTolerance = 0.25;
+    pState->run.startTime = getTimeSeconds();
+    double frameBudgetMs = 1000.0 / 60.0;
+    const char* resolutionTraceFilename = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-depth-prepass") == 0) {
+            pState->options.enableDepthPrePass = false;
+        } else if (strcmp(argv[i], "--no-sort") == 0) {
+            pState->options.enableFrontToBackSort = false;
+        } else if (strcmp(argv[i], "--meshlets") == 0) {
+            pState->options.enableMeshlets = true;
+        } else if (strcmp(argv[i], "--no-mesh-shader") == 0) {
+            pState->options.enableMeshShader = false;
+        } else if (strcmp(argv[i], "--virtual-texture") == 0) {
+            pState->options.enableVirtualTexture = true;
+        } else if (strcmp(argv[i], "--no-sparse") == 0) {
+            pState->options.enableSparseResidency = false;
+        } else if (strcmp(argv[i], "--no-timeline") == 0) {
+            pState->options.enableTimelineSemaphore = false;
+        } else if (strcmp(argv[i], "--dynamic-resolution") == 0) {
+            pState->options.enableDynamicResolution = true;
+        } else if (strcmp(argv[i], "--frame-budget-ms") == 0 && i + 1 < argc) {
+            frameBudgetMs = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--resolution-trace") == 0 && i + 1 < argc) {
+            resolutionTraceFilename = argv[++i];
+        } else if (strcmp(argv[i], "--no-idle") == 0) {
+            pState->options.enableIdle = false;
+        } else if (strcmp(argv[i], "--no-submit-thread") == 0) {
+            pState->options.enableSubmitThread = false;
+        } else if (strcmp(argv[i], "--bench-sync") == 0) {
+            pState->options.benchSync = true;
+        } else if (strcmp(argv[i], "--bench-submit") == 0) {
+            pState->options.benchSubmit = true;
+        } else if (strcmp(argv[i], "--bench-draw-calls") == 0) {
+            pState->options.benchDrawCalls = true;
+        } else if (strcmp(argv[i], "--no-validation") == 0) {
+            pState->options.enableValidationLayers = false;
+        } else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc) {
+            pState->options.referenceDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--record-reference") == 0 && i + 1 < argc) {
+            pState->options.referenceDirectory = argv[++i];
+            pState->options.recordReference = true;
+        } else if (strcmp(argv[i], "--frame-time-tolerance") == 0 && i + 1 < argc) {
+            pState->options.frameTimeTolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--inject-device-lost") == 0 && i + 1 < argc) {
+            pState->options.injectDeviceLostInterval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            pState->options.meshFilename = argv[++i];
+        } else if (strcmp(argv[i], "--bench-mesh") == 0 && i + 2 < argc) {
+            pState->options.benchMeshFilename = argv[++i];
+            pState->options.benchRawMeshFilename = argv[++i];
+        }
+    }
+
+    // Benchmarks and reference runs measure rendering, so they render every frame.
+    if (pState->options.referenceDirectory != NULL || pState->options.benchMeshFilename != NULL || pState->options.benchSync || pState->options.benchSubmit ||
+        pState->options.benchDrawCalls) {
+        pState->options.enableIdle = false;
+    }
+
+    // Reference images have to match from run to run and benchmarks compare runs, so both keep the full resolution.
+    if (pState->options.enableDynamicResolution && (pState->options.referenceDirectory != NULL || pState->options.benchMeshFilename != NULL ||
+                                            pState->options.benchSync || pState->options.benchSubmit || pState->options.benchDrawCalls)) {
+        printf("%s - dynamic resolution is ignored for reference runs and benchmarks.\n", __FUNCTION__);
+        pState->options.enableDynamicResolution = false;
+    }
+
+    initDynamicResolution(&pState->run.dynamicResolution, frameBudgetMs);
+    if (pState->options.enableDynamicResolution && resolutionTraceFilename != NULL) {
+        pState->run.dynamicResolution.pTraceFile = fopen(resolutionTraceFilename, "w");
+        if (pState->run.dynamicResolution.pTraceFile == NULL) {
+            printf("%s - file can't be opened! %s\n", __FUNCTION__, resolutionTraceFilename);
+        } else {
+            fprintf(pState->run.dynamicResolution.pTraceFile, "frame,gpu_ms,scale,width,height\n");
+        }
+    }
 
-    initWindow(pState);
+    if (!loadVulkanLoader()) {
+        free(pState);
+        return 1;
+    }
+
+    pState->options.headless = pState->options.referenceDirectory != NULL;
+    if (!pState->options.headless) {
+        initWindow(pState);
+    }
     initVulkan(pState);
-        
-    mainLoop(pState);
+
+    int exitCode = 0;
+    if (pState->options.referenceDirectory != NULL) {
+        exitCode = runReference(pState) ? 0 : 1;
+    } else if (pState->options.benchMeshFilename != NULL) {
+        benchmarkMeshLoading(pState, pState->options.benchMeshFilename, pState->options.benchRawMeshFilename);
+    } else if (pState->options.benchSync) {
+        benchmarkSynchronization(pState);
+    } else if (pState->options.benchSubmit) {
+        benchmarkSubmission(pState);
+    } else if (pState->options.benchDrawCalls) {
+        benchmarkDrawCalls(pState);
+    } else {
+        mainLoop(pState);
+    }
     cleanup(pState);
-    
+    unloadVulkanLoader();
+
     free(pState);
 
-    return 0;
+    return exitCode;
 }
@@ -0,0 +1,141 @@
+#include "mesh_format.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+bool openMeshFile(const char* filename, MeshFile* pMeshFile) {
+    memset(pMeshFile, 0, sizeof(*pMeshFile));
+
+    if (!mapFile(filename, &pMeshFile->mapping)) {
+        return false;
+    }
+
+    const uint8_t* pBytes = pMeshFile->mapping.pData;
+    const size_t size = pMeshFile->mapping.size;
+    const MeshFileHeader* pHeader = (const MeshFileHeader*) pBytes;
+
+    if (size < sizeof(MeshFileHeader) || pHeader->magic != MESH_FILE_MAGIC) {
+        printf("%s - not a mesh file! %s\n", __FUNCTION__, filename);
+        closeMeshFile(pMeshFile);
+        return false;
+    }
+
+    if (pHeader->version != MESH_FILE_VERSION) {
+        printf("%s - unsupported mesh file version %u! %s\n", __FUNCTION__, pHeader->version, filename);
+        closeMeshFile(pMeshFile);
+        return false;
+    }
+
+    if (pHeader->indexSize != 2 && pHeader->indexSize != 4) {
+        printf("%s - invalid index size %u! %s\n", __FUNCTION__, pHeader->indexSize, filename);
+        closeMeshFile(pMeshFile);
+        return false;
+    }
+
+    // Vulkan buffers can't be empty, so neither can a mesh.
+    if (pHeader->vertexCount == 0 || pHeader->indexCount == 0) {
+        printf("%s - mesh has no vertices or indices! %s\n", __FUNCTION__, filename);
+        closeMeshFile(pMeshFile);
+        return false;
+    }
+
+    if (sizeof(MeshFileHeader) + (uint64_t) pHeader->sectionCount * sizeof(MeshFileSection) > size) {
+        printf("%s - truncated section table! %s\n", __FUNCTION__, filename);
+        closeMeshFile(pMeshFile);
+        return false;
+    }
+
+    const MeshFileSection* pSections = (const MeshFileSection*) (pBytes + sizeof(MeshFileHeader));
+    for (uint32_t i = 0; i < pHeader->sectionCount; ++i) {
+        if (pSections[i].offset > size || pSections[i].size > size - pSections[i].offset) {
+            printf("%s - section %u out of bounds! %s\n", __FUNCTION__, i, filename);
+            closeMeshFile(pMeshFile);
+            return false;
+        }
+    }
+
+    pMeshFile->pHeader = pHeader;
+    pMeshFile->pSections = pSections;
+    return true;
+}
+
+void closeMeshFile(MeshFile* pMeshFile) {
+    unmapFile(&pMeshFile->mapping);
+    pMeshFile->pHeader = NULL;
+    pMeshFile->pSections = NULL;
+}
+
+const void* findMeshSection(const MeshFile* pMeshFile, MeshSectionType type, uint64_t* pSize) {
+    for (uint32_t i = 0; i < pMeshFile->pHeader->sectionCount; ++i) {
+        if (pMeshFile->pSections[i].type == type) {
+            if (pSize != NULL) {
+                *pSize = pMeshFile->pSections[i].size;
+            }
+            return (const uint8_t*) pMeshFile->mapping.pData + pMeshFile->pSections[i].offset;
+        }
+    }
+
+    if (pSize != NULL) {
+        *pSize = 0;
+    }
+    return NULL;
+}
+
+static float clampf(float value, float min, float max) {
+    return value < min ? min : (value > max ? max : value);
+}
+
+static float signNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+void packMeshVertex(const float boundsMin[3], const float boundsMax[3], const MeshFloatVertex* pVertex, MeshPackedVertex* pPacked) {
+    for (int i = 0; i < 3; ++i) {
+        float extent = boundsMax[i] - boundsMin[i];
+        float normalized = extent > 0.0f ? (pVertex->position[i] - boundsMin[i]) / extent : 0.0f;
+        pPacked->position[i] = (uint16_t) lroundf(clampf(normalized, 0.0f, 1.0f) * 65535.0f);
+    }
+
+    // Octahedral encoding, see "A Survey of Efficient Representations for Independent Unit Vectors".
+    const float* n = pVertex->normal;
+    float l1Norm = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float octX = l1Norm > 0.0f ? n[0] / l1Norm : 0.0f;
+    float octY = l1Norm > 0.0f ? n[1] / l1Norm : 0.0f;
+    if (n[2] < 0.0f) {
+        float foldedX = (1.0f - fabsf(octY)) * signNotZero(octX);
+        float foldedY = (1.0f - fabsf(octX)) * signNotZero(octY);
+        octX = foldedX;
+        octY = foldedY;
+    }
+    pPacked->normal[0] = (int8_t) lroundf(clampf(octX, -1.0f, 1.0f) * 127.0f);
+    pPacked->normal[1] = (int8_t) lroundf(clampf(octY, -1.0f, 1.0f) * 127.0f);
+
+    for (int i = 0; i < 3; ++i) {
+        pPacked->color[i] = (uint8_t) lroundf(clampf(pVertex->color[i], 0.0f, 1.0f) * 255.0f);
+    }
+    pPacked->color[3] = 255;
+}
+
+void unpackMeshVertex(const float boundsMin[3], const float boundsMax[3], const MeshPackedVertex* pPacked, MeshFloatVertex* pVertex) {
+    // Must match mesh_decode.comp.
+    for (int i = 0; i < 3; ++i) {
+        pVertex->position[i] = boundsMin[i] + (float) pPacked->position[i] / 65535.0f * (boundsMax[i] - boundsMin[i]);
+    }
+
+    float octX = clampf((float) pPacked->normal[0] / 127.0f, -1.0f, 1.0f);
+    float octY = clampf((float) pPacked->normal[1] / 127.0f, -1.0f, 1.0f);
+    float n[3] = {octX, octY, 1.0f - fabsf(octX) - fabsf(octY)};
+    if (n[2] < 0.0f) {
+        n[0] = (1.0f - fabsf(octY)) * signNotZero(octX);
+        n[1] = (1.0f - fabsf(octX)) * signNotZero(octY);
+    }
+    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    for (int i = 0; i < 3; ++i) {
+        pVertex->normal[i] = n[i] / length;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        pVertex->color[i] = (float) pPacked->color[i] / 255.0f;
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef MESH_FORMAT_H
+#define MESH_FORMAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "platform.h"
+
+// Compact mesh container written by tools/mesh_convert.c.
+//
+// Layout: MeshFileHeader, then sectionCount MeshFileSection entries, then the section payloads, each 16 byte aligned.
+// Everything is little endian. Readers look sections up by type and skip the ones they don't know, so new sections
+// can be appended without breaking older loaders.
+
+#define MESH_FILE_MAGIC 0x4853454Du // "MESH"
+#define MESH_FILE_VERSION 1
+#define MESH_SECTION_ALIGNMENT 16
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+typedef enum MeshSectionType {
+    // MeshPackedVertex[vertexCount], ordered by first use in the meshlet ordered index stream.
+    MESH_SECTION_VERTICES = 1,
+    // indexCount indices of indexSize bytes, triangles grouped meshlet by meshlet.
+    MESH_SECTION_INDICES = 2,
+    // MeshletRange[meshletCount] describing how the index stream is split into meshlets.
+    MESH_SECTION_MESHLETS = 3,
+    // MeshletBounds[meshletCount], used for per cluster frustum and backface cone culling.
+    MESH_SECTION_MESHLET_BOUNDS = 4,
+    // uint32_t global vertex indices, each meshlet's unique vertices starting at MeshletRange::vertexOffset.
+    MESH_SECTION_MESHLET_VERTICES = 5,
+    // uint8_t meshlet local vertex indices, indexCount of them, laid out exactly like the index stream so
+    // MeshletRange::indexOffset addresses both.
+    MESH_SECTION_MESHLET_TRIANGLES = 6,
+} MeshSectionType;
+
+typedef struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t meshletCount;
+    uint32_t indexSize;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t sectionCount;
+    uint32_t reserved;
+} MeshFileHeader;
+
+typedef struct MeshFileSection {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+} MeshFileSection;
+
+// 12 bytes instead of the 36 of a float position/normal/colour vertex. Position is unorm16 across the mesh bounds,
+// the normal is octahedral encoded into two snorm8, colour is rgba8. Read on the GPU as three uints by mesh_decode.comp.
+typedef struct MeshPackedVertex {
+    uint16_t position[3];
+    int8_t normal[2];
+    uint8_t color[4];
+} MeshPackedVertex;
+
+typedef struct MeshletRange {
+    uint32_t indexOffset;
+    uint32_t triangleCount;
+    uint32_t vertexCount;
+    uint32_t vertexOffset;
+} MeshletRange;
+
+// Two vec4 in the shaders. The cone holds the average normal and the sine of the normals' spread: the cluster is
+// entirely backfacing when dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius.
+// A cutoff of 1 means the normals are too spread to ever cull.
+typedef struct MeshletBounds {
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+} MeshletBounds;
+
+// The float layout we decode into, and what a naive loader would store on disk and upload.
+typedef struct MeshFloatVertex {
+    float position[3];
+    float normal[3];
+    float color[3];
+} MeshFloatVertex;
+
+// Uncompressed reference format used to benchmark against: RawMeshHeader, MeshFloatVertex[vertexCount], uint32_t[indexCount].
+#define RAW_MESH_FILE_MAGIC 0x4D574152u // "RAWM"
+
+typedef struct RawMeshHeader {
+    uint32_t magic;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t reserved;
+} RawMeshHeader;
+
+typedef struct MeshFile {
+    MappedFile mapping;
+    const MeshFileHeader* pHeader;
+    const MeshFileSection* pSections;
+} MeshFile;
+
+bool openMeshFile(const char* filename, MeshFile* pMeshFile);
+void closeMeshFile(MeshFile* pMeshFile);
+
+// Returns the payload of the first section of the given type, or NULL if the file has none.
+const void* findMeshSection(const MeshFile* pMeshFile, MeshSectionType type, uint64_t* pSize);
+
+void packMeshVertex(const float boundsMin[3], const float boundsMax[3], const MeshFloatVertex* pVertex, MeshPackedVertex* pPacked);
+void unpackMeshVertex(const float boundsMin[3], const float boundsMax[3], const MeshPackedVertex* pPacked, MeshFloatVertex* pVertex);
+
+#endif //MESH_FORMAT_H
@@ -0,0 +1,50 @@
+#include "mpsc_queue.h"
+
+#include <stddef.h>
+
+void initMpscQueue(MpscQueue* pQueue) {
+    atomic_init(&pQueue->stub.pNext, NULL);
+    atomic_init(&pQueue->pHead, &pQueue->stub);
+    pQueue->pTail = &pQueue->stub;
+}
+
+void pushMpscQueue(MpscQueue* pQueue, MpscNode* pNode) {
+    atomic_store_explicit(&pNode->pNext, NULL, memory_order_relaxed);
+
+    // The exchange is the only point producers contend on. Linking the previous head afterwards publishes the node.
+    MpscNode* pPrevious = atomic_exchange_explicit(&pQueue->pHead, pNode, memory_order_acq_rel);
+    atomic_store_explicit(&pPrevious->pNext, pNode, memory_order_release);
+}
+
+MpscNode* popMpscQueue(MpscQueue* pQueue) {
+    MpscNode* pTail = pQueue->pTail;
+    MpscNode* pNext = atomic_load_explicit(&pTail->pNext, memory_order_acquire);
+
+    if (pTail == &pQueue->stub) {
+        if (pNext == NULL) {
+            return NULL;
+        }
+        pQueue->pTail = pNext;
+        pTail = pNext;
+        pNext = atomic_load_explicit(&pNext->pNext, memory_order_acquire);
+    }
+
+    if (pNext != NULL) {
+        pQueue->pTail = pNext;
+        return pTail;
+    }
+
+    if (pTail != atomic_load_explicit(&pQueue->pHead, memory_order_acquire)) {
+        return NULL;
+    }
+
+    // pTail is the last node. Push the stub behind it so it can be unlinked without losing the list.
+    pushMpscQueue(pQueue, &pQueue->stub);
+
+    pNext = atomic_load_explicit(&pTail->pNext, memory_order_acquire);
+    if (pNext != NULL) {
+        pQueue->pTail = pNext;
+        return pTail;
+    }
+    return NULL;
+}
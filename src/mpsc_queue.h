@@ -0,0 +1,27 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <stdatomic.h>
+
+// Intrusive multi producer single consumer queue (Vyukov). Any thread may push without taking a lock, one thread
+// pops. Nodes are owned by the producer and embedded in its own structs, so the queue never allocates.
+typedef struct MpscNode {
+    struct MpscNode* _Atomic pNext;
+} MpscNode;
+
+typedef struct MpscQueue {
+    MpscNode* _Atomic pHead;
+    // Only touched by the consumer.
+    MpscNode* pTail;
+    MpscNode stub;
+} MpscQueue;
+
+void initMpscQueue(MpscQueue* pQueue);
+
+void pushMpscQueue(MpscQueue* pQueue, MpscNode* pNode);
+
+// Returns the oldest node, or NULL when the queue is empty or a producer is halfway through a push. In the latter
+// case the producer finishes without waiting and the node shows up on the next pop.
+MpscNode* popMpscQueue(MpscQueue* pQueue);
+
+#endif //MPSC_QUEUE_H
@@ -0,0 +1,344 @@
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+#endif
+
+#ifdef _WIN32
+
+bool mapFile(const char* filename, MappedFile* pFile) {
+    memset(pFile, 0, sizeof(*pFile));
+
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        printf("%s - file can't be opened! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        printf("%s - failed to map file! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    pFile->pData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (pFile->pData == NULL) {
+        printf("%s - failed to map view of file! %s\n", __FUNCTION__, filename);
+        CloseHandle(mapping);
+        return false;
+    }
+
+    pFile->size = (size_t) size.QuadPart;
+    pFile->pPlatformHandle = mapping;
+    return true;
+}
+
+void unmapFile(MappedFile* pFile) {
+    if (pFile->pData != NULL) {
+        UnmapViewOfFile(pFile->pData);
+        CloseHandle((HANDLE) pFile->pPlatformHandle);
+    }
+    memset(pFile, 0, sizeof(*pFile));
+}
+
+double getTimeSeconds() {
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+}
+
+double getThreadCpuSeconds() {
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0.0;
+    }
+
+    // Both are in 100 ns units.
+    ULARGE_INTEGER kernel = {.LowPart = kernelTime.dwLowDateTime, .HighPart = kernelTime.dwHighDateTime};
+    ULARGE_INTEGER user = {.LowPart = userTime.dwLowDateTime, .HighPart = userTime.dwHighDateTime};
+    return (double) (kernel.QuadPart + user.QuadPart) * 1e-7;
+}
+
+double getProcessCpuSeconds() {
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0.0;
+    }
+
+    ULARGE_INTEGER kernel = {.LowPart = kernelTime.dwLowDateTime, .HighPart = kernelTime.dwHighDateTime};
+    ULARGE_INTEGER user = {.LowPart = userTime.dwLowDateTime, .HighPart = userTime.dwHighDateTime};
+    return (double) (kernel.QuadPart + user.QuadPart) * 1e-7;
+}
+
+size_t getHeapBytesInUse() {
+    size_t bytes = 0;
+    _HEAPINFO info = {0};
+    while (_heapwalk(&info) == _HEAPOK) {
+        if (info._useflag == _USEDENTRY) {
+            bytes += info._size;
+        }
+    }
+    return bytes;
+}
+
+struct PlatformThread {
+    HANDLE handle;
+    void (*pFunction)(void*);
+    void* pArgument;
+};
+
+static DWORD WINAPI threadEntry(LPVOID pParameter) {
+    PlatformThread* pThread = pParameter;
+    pThread->pFunction(pThread->pArgument);
+    return 0;
+}
+
+PlatformThread* startThread(void (*pFunction)(void*), void* pArgument) {
+    PlatformThread* pThread = malloc(sizeof(*pThread));
+    pThread->pFunction = pFunction;
+    pThread->pArgument = pArgument;
+
+    pThread->handle = CreateThread(NULL, 0, threadEntry, pThread, 0, NULL);
+    if (pThread->handle == NULL) {
+        printf("%s - failed to create thread!\n", __FUNCTION__);
+        free(pThread);
+        return NULL;
+    }
+    return pThread;
+}
+
+void joinThread(PlatformThread* pThread) {
+    WaitForSingleObject(pThread->handle, INFINITE);
+    CloseHandle(pThread->handle);
+    free(pThread);
+}
+
+struct PlatformSemaphore {
+    HANDLE handle;
+};
+
+PlatformSemaphore* createPlatformSemaphore() {
+    PlatformSemaphore* pSemaphore = malloc(sizeof(*pSemaphore));
+    pSemaphore->handle = CreateSemaphoreA(NULL, 0, MAXLONG, NULL);
+    if (pSemaphore->handle == NULL) {
+        printf("%s - failed to create semaphore!\n", __FUNCTION__);
+    }
+    return pSemaphore;
+}
+
+void destroyPlatformSemaphore(PlatformSemaphore* pSemaphore) {
+    CloseHandle(pSemaphore->handle);
+    free(pSemaphore);
+}
+
+void postPlatformSemaphore(PlatformSemaphore* pSemaphore) {
+    ReleaseSemaphore(pSemaphore->handle, 1, NULL);
+}
+
+bool waitPlatformSemaphore(PlatformSemaphore* pSemaphore, double timeoutSeconds) {
+    return WaitForSingleObject(pSemaphore->handle, (DWORD) (timeoutSeconds * 1000.0)) == WAIT_OBJECT_0;
+}
+
+void* loadSharedLibrary(const char* filename) {
+    return LoadLibraryA(filename);
+}
+
+void* getSharedLibrarySymbol(void* pLibrary, const char* pName) {
+    return (void*) GetProcAddress((HMODULE) pLibrary, pName);
+}
+
+void unloadSharedLibrary(void* pLibrary) {
+    FreeLibrary((HMODULE) pLibrary);
+}
+
+#else
+
+bool mapFile(const char* filename, MappedFile* pFile) {
+    memset(pFile, 0, sizeof(*pFile));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        printf("%s - file can't be opened! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        printf("%s - failed to stat file! %s\n", __FUNCTION__, filename);
+        close(fd);
+        return false;
+    }
+
+    void* pData = mmap(NULL, (size_t) fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (pData == MAP_FAILED) {
+        printf("%s - failed to map file! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    // The loader reads front to back exactly once.
+    madvise(pData, (size_t) fileStat.st_size, MADV_SEQUENTIAL);
+
+    pFile->pData = pData;
+    pFile->size = (size_t) fileStat.st_size;
+    return true;
+}
+
+void unmapFile(MappedFile* pFile) {
+    if (pFile->pData != NULL) {
+        munmap((void*) pFile->pData, pFile->size);
+    }
+    memset(pFile, 0, sizeof(*pFile));
+}
+
+double getTimeSeconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
+
+double getThreadCpuSeconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
+
+double getProcessCpuSeconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
+
+size_t getHeapBytesInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo info = mallinfo();
+    return (size_t) (unsigned int) info.uordblks + (size_t) (unsigned int) info.hblkhd;
+#elif defined(__APPLE__)
+    return mstats().bytes_used;
+#else
+    return 0;
+#endif
+}
+
+struct PlatformThread {
+    pthread_t handle;
+    void (*pFunction)(void*);
+    void* pArgument;
+};
+
+static void* threadEntry(void* pParameter) {
+    PlatformThread* pThread = pParameter;
+    pThread->pFunction(pThread->pArgument);
+    return NULL;
+}
+
+PlatformThread* startThread(void (*pFunction)(void*), void* pArgument) {
+    PlatformThread* pThread = malloc(sizeof(*pThread));
+    pThread->pFunction = pFunction;
+    pThread->pArgument = pArgument;
+
+    if (pthread_create(&pThread->handle, NULL, threadEntry, pThread) != 0) {
+        printf("%s - failed to create thread!\n", __FUNCTION__);
+        free(pThread);
+        return NULL;
+    }
+    return pThread;
+}
+
+void joinThread(PlatformThread* pThread) {
+    pthread_join(pThread->handle, NULL);
+    free(pThread);
+}
+
+// POSIX semaphores have no timed wait on every platform, so this is a count behind a condition variable.
+struct PlatformSemaphore {
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    unsigned count;
+};
+
+PlatformSemaphore* createPlatformSemaphore() {
+    PlatformSemaphore* pSemaphore = malloc(sizeof(*pSemaphore));
+    pthread_mutex_init(&pSemaphore->mutex, NULL);
+    pthread_cond_init(&pSemaphore->condition, NULL);
+    pSemaphore->count = 0;
+    return pSemaphore;
+}
+
+void destroyPlatformSemaphore(PlatformSemaphore* pSemaphore) {
+    pthread_cond_destroy(&pSemaphore->condition);
+    pthread_mutex_destroy(&pSemaphore->mutex);
+    free(pSemaphore);
+}
+
+void postPlatformSemaphore(PlatformSemaphore* pSemaphore) {
+    pthread_mutex_lock(&pSemaphore->mutex);
+    pSemaphore->count++;
+    pthread_cond_signal(&pSemaphore->condition);
+    pthread_mutex_unlock(&pSemaphore->mutex);
+}
+
+bool waitPlatformSemaphore(PlatformSemaphore* pSemaphore, double timeoutSeconds) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    long long nanoseconds = deadline.tv_nsec + (long long) (timeoutSeconds * 1e9);
+    deadline.tv_sec += (time_t) (nanoseconds / 1000000000LL);
+    deadline.tv_nsec = (long) (nanoseconds % 1000000000LL);
+
+    pthread_mutex_lock(&pSemaphore->mutex);
+    int result = 0;
+    while (pSemaphore->count == 0 && result == 0) {
+        result = pthread_cond_timedwait(&pSemaphore->condition, &pSemaphore->mutex, &deadline);
+    }
+    bool signalled = pSemaphore->count > 0;
+    if (signalled) {
+        pSemaphore->count--;
+    }
+    pthread_mutex_unlock(&pSemaphore->mutex);
+    return signalled;
+}
+
+void* loadSharedLibrary(const char* filename) {
+    return dlopen(filename, RTLD_NOW | RTLD_LOCAL);
+}
+
+void* getSharedLibrarySymbol(void* pLibrary, const char* pName) {
+    return dlsym(pLibrary, pName);
+}
+
+void unloadSharedLibrary(void* pLibrary) {
+    dlclose(pLibrary);
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Read-only view of a whole file. On both Windows and POSIX the pages are faulted in lazily as they are touched,
+// so streaming a large file through a small staging buffer never needs a heap copy of it.
+typedef struct MappedFile {
+    const void* pData;
+    size_t size;
+    void* pPlatformHandle;
+} MappedFile;
+
+bool mapFile(const char* filename, MappedFile* pFile);
+void unmapFile(MappedFile* pFile);
+
+// Monotonic wall clock in seconds.
+double getTimeSeconds();
+
+// CPU time consumed by the calling thread in seconds, user and kernel.
+double getThreadCpuSeconds();
+// CPU time consumed by all threads of the process in seconds, user and kernel.
+double getProcessCpuSeconds();
+
+// Bytes currently allocated from the C heap, including large blocks the allocator maps directly. Walks the heap on
+// Windows, so it is meant for benchmarks, not per-frame use. Returns 0 where the allocator can't be queried.
+size_t getHeapBytesInUse();
+
+typedef struct PlatformThread PlatformThread;
+
+PlatformThread* startThread(void (*pFunction)(void*), void* pArgument);
+// Waits for the thread to return and frees it.
+void joinThread(PlatformThread* pThread);
+
+// Counting semaphore used to wake a sleeping thread.
+typedef struct PlatformSemaphore PlatformSemaphore;
+
+PlatformSemaphore* createPlatformSemaphore();
+void destroyPlatformSemaphore(PlatformSemaphore* pSemaphore);
+void postPlatformSemaphore(PlatformSemaphore* pSemaphore);
+// Returns false if timeoutSeconds passed without a post.
+bool waitPlatformSemaphore(PlatformSemaphore* pSemaphore, double timeoutSeconds);
+
+// Returns NULL if the library can't be found or loaded.
+void* loadSharedLibrary(const char* filename);
+void* getSharedLibrarySymbol(void* pLibrary, const char* pName);
+void unloadSharedLibrary(void* pLibrary);
+
+#endif //PLATFORM_H
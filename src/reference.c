@@ -0,0 +1,152 @@
+#include "reference.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const uint32_t referenceCaptureFrames[REFERENCE_CAPTURE_COUNT] = {0, 1, 7, REFERENCE_FRAME_COUNT - 1};
+
+uint64_t hashImage(const uint8_t* pRgba, uint32_t width, uint32_t height) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    const size_t pixelCount = (size_t) width * height;
+
+    for (size_t i = 0; i < pixelCount; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            hash ^= pRgba[i * 4 + c];
+            hash *= 0x100000001B3ull;
+        }
+    }
+    return hash;
+}
+
+bool writePpm(const char* filename, const uint8_t* pRgba, uint32_t width, uint32_t height) {
+    FILE* pFile = fopen(filename, "wb");
+    if (pFile == NULL) {
+        printf("%s - file can't be opened! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    fprintf(pFile, "P6\n%u %u\n255\n", width, height);
+
+    uint8_t* pRow = malloc((size_t) width * 3);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            memcpy(pRow + x * 3, pRgba + ((size_t) y * width + x) * 4, 3);
+        }
+        fwrite(pRow, 3, width, pFile);
+    }
+    free(pRow);
+
+    fclose(pFile);
+    return true;
+}
+
+uint8_t* readPpm(const char* filename, uint32_t* pWidth, uint32_t* pHeight) {
+    FILE* pFile = fopen(filename, "rb");
+    if (pFile == NULL) {
+        printf("%s - file can't be opened! %s\n", __FUNCTION__, filename);
+        return NULL;
+    }
+
+    unsigned width, height, maxValue;
+    if (fscanf(pFile, "P6 %u %u %u", &width, &height, &maxValue) != 3 || maxValue != 255 || fgetc(pFile) == EOF) {
+        printf("%s - not an 8 bit binary PPM! %s\n", __FUNCTION__, filename);
+        fclose(pFile);
+        return NULL;
+    }
+
+    const size_t size = (size_t) width * height * 3;
+    uint8_t* pRgb = malloc(size);
+    if (fread(pRgb, 1, size, pFile) != size) {
+        printf("%s - file is truncated! %s\n", __FUNCTION__, filename);
+        free(pRgb);
+        fclose(pFile);
+        return NULL;
+    }
+
+    fclose(pFile);
+    *pWidth = width;
+    *pHeight = height;
+    return pRgb;
+}
+
+uint32_t countDifferingPixels(const uint8_t* pRgba, const uint8_t* pGoldenRgb, uint32_t pixelCount, uint8_t channelTolerance) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < pixelCount; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            int difference = (int) pRgba[i * 4 + c] - (int) pGoldenRgb[i * 3 + c];
+            if (abs(difference) > channelTolerance) {
+                count++;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+static int compareDoubles(const void* pA, const void* pB) {
+    double a = *(const double*) pA;
+    double b = *(const double*) pB;
+    return (a > b) - (a < b);
+}
+
+void computeFrameTimePercentiles(double* pFrameMs, uint32_t count, double* pMedian, double* pP95) {
+    if (count == 0) {
+        *pMedian = 0.0;
+        *pP95 = 0.0;
+        return;
+    }
+
+    qsort(pFrameMs, count, sizeof(double), compareDoubles);
+    *pMedian = pFrameMs[count / 2];
+    *pP95 = pFrameMs[(count * 95) / 100 < count ? (count * 95) / 100 : count - 1];
+}
+
+// Plain text so a baseline change shows up readably in review:
+//   size 800 600
+//   hash <capture index> <16 hex digits>
+//   median_ms 1.234
+//   p95_ms 2.345
+bool readReferenceBaseline(const char* filename, ReferenceBaseline* pBaseline) {
+    memset(pBaseline, 0, sizeof(*pBaseline));
+
+    FILE* pFile = fopen(filename, "r");
+    if (pFile == NULL) {
+        printf("%s - file can't be opened! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), pFile) != NULL) {
+        unsigned index;
+        unsigned long long hash;
+        if (sscanf(line, "hash %u %llx", &index, &hash) == 2 && index < REFERENCE_CAPTURE_COUNT) {
+            pBaseline->frameHashes[index] = hash;
+        } else {
+            sscanf(line, "size %u %u", &pBaseline->width, &pBaseline->height);
+            sscanf(line, "median_ms %lf", &pBaseline->medianFrameMs);
+            sscanf(line, "p95_ms %lf", &pBaseline->p95FrameMs);
+        }
+    }
+
+    fclose(pFile);
+    return pBaseline->width != 0 && pBaseline->height != 0;
+}
+
+bool writeReferenceBaseline(const char* filename, const ReferenceBaseline* pBaseline) {
+    FILE* pFile = fopen(filename, "w");
+    if (pFile == NULL) {
+        printf("%s - file can't be opened! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    fprintf(pFile, "size %u %u\n", pBaseline->width, pBaseline->height);
+    for (uint32_t i = 0; i < REFERENCE_CAPTURE_COUNT; ++i) {
+        fprintf(pFile, "hash %u %016llx\n", i, (unsigned long long) pBaseline->frameHashes[i]);
+    }
+    fprintf(pFile, "median_ms %.4f\n", pBaseline->medianFrameMs);
+    fprintf(pFile, "p95_ms %.4f\n", pBaseline->p95FrameMs);
+
+    fclose(pFile);
+    return true;
+}
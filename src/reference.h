@@ -0,0 +1,45 @@
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Frames whose output is checked against the golden images. Frame 0 sees cold caches and an empty virtual texture,
+// the later ones the settled state.
+#define REFERENCE_FRAME_COUNT 64
+#define REFERENCE_CAPTURE_COUNT 4
+// Frames before this one are left out of the timing, they include pipeline and page-in warm up.
+#define REFERENCE_FIRST_TIMED_FRAME 8
+
+// An image whose hash differs still passes if at most this fraction of its pixels differ by more than the channel
+// tolerance, which absorbs rounding differences between rasteriser versions.
+#define REFERENCE_CHANNEL_TOLERANCE 2
+#define REFERENCE_PIXEL_TOLERANCE 0.001
+
+extern const uint32_t referenceCaptureFrames[REFERENCE_CAPTURE_COUNT];
+
+typedef struct ReferenceBaseline {
+    uint32_t width;
+    uint32_t height;
+    uint64_t frameHashes[REFERENCE_CAPTURE_COUNT];
+    double medianFrameMs;
+    double p95FrameMs;
+} ReferenceBaseline;
+
+// FNV-1a over the RGB channels, alpha is ignored so it matches the PPM files.
+uint64_t hashImage(const uint8_t* pRgba, uint32_t width, uint32_t height);
+
+bool writePpm(const char* filename, const uint8_t* pRgba, uint32_t width, uint32_t height);
+// Returns an RGB buffer the caller frees, or NULL.
+uint8_t* readPpm(const char* filename, uint32_t* pWidth, uint32_t* pHeight);
+
+// Pixels where any channel is further than channelTolerance from the golden RGB image.
+uint32_t countDifferingPixels(const uint8_t* pRgba, const uint8_t* pGoldenRgb, uint32_t pixelCount, uint8_t channelTolerance);
+
+// Sorts pFrameMs in place.
+void computeFrameTimePercentiles(double* pFrameMs, uint32_t count, double* pMedian, double* pP95);
+
+bool readReferenceBaseline(const char* filename, ReferenceBaseline* pBaseline);
+bool writeReferenceBaseline(const char* filename, const ReferenceBaseline* pBaseline);
+
+#endif //REFERENCE_H
@@ -0,0 +1,98 @@
+#include "resource_manifest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void initResourceManifest(ResourceManifest* pManifest) {
+    memset(pManifest, 0, sizeof(*pManifest));
+}
+
+void destroyResourceManifest(ResourceManifest* pManifest) {
+    free(pManifest->pObjects);
+    memset(pManifest, 0, sizeof(*pManifest));
+}
+
+void beginManifestStep(ResourceManifest* pManifest, uint32_t step) {
+    if (pManifest->stepCount < MANIFEST_MAX_STEPS) {
+        pManifest->steps[pManifest->stepCount] = step;
+    }
+    pManifest->recording = true;
+}
+
+void endManifestStep(ResourceManifest* pManifest, double seconds) {
+    if (pManifest->stepCount < MANIFEST_MAX_STEPS) {
+        pManifest->stepSeconds[pManifest->stepCount++] = seconds;
+    }
+    pManifest->recording = false;
+}
+
+void recordManifestObject(ResourceManifest* pManifest, ManifestObjectType type, uint64_t parameter0, uint64_t parameter1,
+                          uint64_t parameter2, const char* pName) {
+    if (!pManifest->recording) {
+        return;
+    }
+
+    if (pManifest->objectCount == pManifest->objectCapacity) {
+        pManifest->objectCapacity = pManifest->objectCapacity == 0 ? 64 : pManifest->objectCapacity * 2;
+        pManifest->pObjects = realloc(pManifest->pObjects, sizeof(ManifestObject) * pManifest->objectCapacity);
+    }
+
+    ManifestObject object = {
+            .type = type,
+            .step = pManifest->steps[pManifest->stepCount < MANIFEST_MAX_STEPS ? pManifest->stepCount : MANIFEST_MAX_STEPS - 1],
+            .parameters = {parameter0, parameter1, parameter2},
+            .pName = pName,
+    };
+    pManifest->pObjects[pManifest->objectCount++] = object;
+}
+
+const char* getManifestObjectTypeName(ManifestObjectType type) {
+    static const char* names[MANIFEST_OBJECT_TYPE_COUNT] = {
+            "instance",
+            "debug messenger",
+            "device",
+            "surface",
+            "swapchain",
+            "device memory",
+            "buffer",
+            "image",
+            "image view",
+            "sampler",
+            "render pass",
+            "framebuffer",
+            "shader module",
+            "pipeline cache",
+            "pipeline layout",
+            "pipeline",
+            "descriptor set layout",
+            "descriptor pool",
+            "descriptor set",
+            "command pool",
+            "command buffer",
+            "semaphore",
+            "fence",
+            "query pool",
+    };
+    return type < MANIFEST_OBJECT_TYPE_COUNT ? names[type] : "unknown";
+}
+
+void countManifestObjects(const ResourceManifest* pManifest, uint32_t pCounts[MANIFEST_OBJECT_TYPE_COUNT]) {
+    memset(pCounts, 0, sizeof(uint32_t) * MANIFEST_OBJECT_TYPE_COUNT);
+    for (uint32_t i = 0; i < pManifest->objectCount; ++i) {
+        pCounts[pManifest->pObjects[i].type]++;
+    }
+}
+
+uint32_t findManifestMismatch(const ResourceManifest* pExpected, const ResourceManifest* pActual) {
+    uint32_t count = pExpected->objectCount < pActual->objectCount ? pExpected->objectCount : pActual->objectCount;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const ManifestObject* pA = &pExpected->pObjects[i];
+        const ManifestObject* pB = &pActual->pObjects[i];
+        if (pA->type != pB->type || pA->step != pB->step || memcmp(pA->parameters, pB->parameters, sizeof(pA->parameters)) != 0) {
+            return i;
+        }
+    }
+
+    return pExpected->objectCount == pActual->objectCount ? UINT32_MAX : count;
+}
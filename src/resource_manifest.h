@@ -0,0 +1,77 @@
+#ifndef RESOURCE_MANIFEST_H
+#define RESOURCE_MANIFEST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MANIFEST_MAX_STEPS 32
+
+typedef enum ManifestObjectType {
+    MANIFEST_OBJECT_INSTANCE,
+    MANIFEST_OBJECT_DEBUG_MESSENGER,
+    MANIFEST_OBJECT_DEVICE,
+    MANIFEST_OBJECT_SURFACE,
+    MANIFEST_OBJECT_SWAPCHAIN,
+    MANIFEST_OBJECT_MEMORY,
+    MANIFEST_OBJECT_BUFFER,
+    MANIFEST_OBJECT_IMAGE,
+    MANIFEST_OBJECT_IMAGE_VIEW,
+    MANIFEST_OBJECT_SAMPLER,
+    MANIFEST_OBJECT_RENDER_PASS,
+    MANIFEST_OBJECT_FRAMEBUFFER,
+    MANIFEST_OBJECT_SHADER_MODULE,
+    MANIFEST_OBJECT_PIPELINE_CACHE,
+    MANIFEST_OBJECT_PIPELINE_LAYOUT,
+    MANIFEST_OBJECT_PIPELINE,
+    MANIFEST_OBJECT_DESCRIPTOR_SET_LAYOUT,
+    MANIFEST_OBJECT_DESCRIPTOR_POOL,
+    MANIFEST_OBJECT_DESCRIPTOR_SET,
+    MANIFEST_OBJECT_COMMAND_POOL,
+    MANIFEST_OBJECT_COMMAND_BUFFER,
+    MANIFEST_OBJECT_SEMAPHORE,
+    MANIFEST_OBJECT_FENCE,
+    MANIFEST_OBJECT_QUERY_POOL,
+    MANIFEST_OBJECT_TYPE_COUNT
+} ManifestObjectType;
+
+// One created or allocated object. What the parameters hold depends on the type, e.g. size, usage and memory
+// properties for a buffer, width, height and format for an image, size, memory type index and properties for device
+// memory, or level and count for command buffers; unused ones are 0. pName is a static string such as a shader path
+// or the layout a descriptor set was allocated with.
+typedef struct ManifestObject {
+    ManifestObjectType type;
+    uint32_t step;
+    uint64_t parameters[3];
+    const char* pName;
+} ManifestObject;
+
+// Everything an application run created on the device, in creation order, grouped by the init step that created it.
+// Steps are application defined ids, so replaying them in order rebuilds the same set of objects.
+typedef struct ResourceManifest {
+    uint32_t steps[MANIFEST_MAX_STEPS];
+    double stepSeconds[MANIFEST_MAX_STEPS];
+    uint32_t stepCount;
+    // Objects are only recorded while a step is running, temporary objects of benchmarks and the like are not.
+    bool recording;
+
+    ManifestObject* pObjects;
+    uint32_t objectCount;
+    uint32_t objectCapacity;
+} ResourceManifest;
+
+void initResourceManifest(ResourceManifest* pManifest);
+void destroyResourceManifest(ResourceManifest* pManifest);
+
+void beginManifestStep(ResourceManifest* pManifest, uint32_t step);
+void endManifestStep(ResourceManifest* pManifest, double seconds);
+
+void recordManifestObject(ResourceManifest* pManifest, ManifestObjectType type, uint64_t parameter0, uint64_t parameter1,
+                          uint64_t parameter2, const char* pName);
+
+const char* getManifestObjectTypeName(ManifestObjectType type);
+void countManifestObjects(const ResourceManifest* pManifest, uint32_t pCounts[MANIFEST_OBJECT_TYPE_COUNT]);
+
+// Index of the first object whose type, step or parameters differ, or UINT32_MAX when both list the same objects.
+uint32_t findManifestMismatch(const ResourceManifest* pExpected, const ResourceManifest* pActual);
+
+#endif //RESOURCE_MANIFEST_H
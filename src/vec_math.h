@@ -0,0 +1,111 @@
+#ifndef VEC_MATH_H
+#define VEC_MATH_H
+
+#include <math.h>
+
+// Column major, matching GLSL mat4 layout so it can be pushed straight into push constants.
+typedef struct Mat4 {
+    float m[16];
+} Mat4;
+
+typedef struct Vec3 {
+    float x;
+    float y;
+    float z;
+} Vec3;
+
+static inline Vec3 vec3Sub(Vec3 a, Vec3 b) {
+    return (Vec3) {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+static inline float vec3Dot(Vec3 a, Vec3 b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline Vec3 vec3Cross(Vec3 a, Vec3 b) {
+    return (Vec3) {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+static inline Vec3 vec3Normalize(Vec3 v) {
+    float length = sqrtf(vec3Dot(v, v));
+    return length > 0.0f ? (Vec3) {v.x / length, v.y / length, v.z / length} : v;
+}
+
+static inline Mat4 mat4Identity() {
+    Mat4 result = {{1, 0, 0, 0,
+                    0, 1, 0, 0,
+                    0, 0, 1, 0,
+                    0, 0, 0, 1}};
+    return result;
+}
+
+static inline Mat4 mat4Multiply(const Mat4* pA, const Mat4* pB) {
+    Mat4 result;
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 4; ++row) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                sum += pA->m[k * 4 + row] * pB->m[column * 4 + k];
+            }
+            result.m[column * 4 + row] = sum;
+        }
+    }
+    return result;
+}
+
+static inline Mat4 mat4Translation(Vec3 t) {
+    Mat4 result = mat4Identity();
+    result.m[12] = t.x;
+    result.m[13] = t.y;
+    result.m[14] = t.z;
+    return result;
+}
+
+static inline Mat4 mat4Scale(Vec3 s) {
+    Mat4 result = mat4Identity();
+    result.m[0] = s.x;
+    result.m[5] = s.y;
+    result.m[10] = s.z;
+    return result;
+}
+
+static inline Mat4 mat4RotationY(float radians) {
+    Mat4 result = mat4Identity();
+    result.m[0] = cosf(radians);
+    result.m[2] = -sinf(radians);
+    result.m[8] = sinf(radians);
+    result.m[10] = cosf(radians);
+    return result;
+}
+
+static inline Vec3 mat4TransformPoint(const Mat4* pM, Vec3 p) {
+    Vec3 result = {
+            pM->m[0] * p.x + pM->m[4] * p.y + pM->m[8] * p.z + pM->m[12],
+            pM->m[1] * p.x + pM->m[5] * p.y + pM->m[9] * p.z + pM->m[13],
+            pM->m[2] * p.x + pM->m[6] * p.y + pM->m[10] * p.z + pM->m[14],
+    };
+    return result;
+}
+
+// Right handed view, Vulkan clip space: y points down and depth maps to [0, 1].
+static inline Mat4 mat4Perspective(float verticalFov, float aspect, float nearZ, float farZ) {
+    float f = 1.0f / tanf(verticalFov * 0.5f);
+    Mat4 result = {{f / aspect, 0, 0, 0,
+                    0, -f, 0, 0,
+                    0, 0, farZ / (nearZ - farZ), -1,
+                    0, 0, nearZ * farZ / (nearZ - farZ), 0}};
+    return result;
+}
+
+static inline Mat4 mat4LookAt(Vec3 eye, Vec3 target, Vec3 up) {
+    Vec3 forward = vec3Normalize(vec3Sub(target, eye));
+    Vec3 right = vec3Normalize(vec3Cross(forward, up));
+    Vec3 cameraUp = vec3Cross(right, forward);
+    Mat4 result = {{right.x, cameraUp.x, -forward.x, 0,
+                    right.y, cameraUp.y, -forward.y, 0,
+                    right.z, cameraUp.z, -forward.z, 0,
+                    -vec3Dot(right, eye), -vec3Dot(cameraUp, eye), vec3Dot(forward, eye), 1}};
+    return result;
+}
+
+#endif //VEC_MATH_H
@@ -0,0 +1,193 @@
+#include "virtual_texture.h"
+
+#include <string.h>
+
+uint32_t getVirtualTextureMipOffset(uint32_t mip) {
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < mip; ++i) {
+        uint32_t pagesPerSide = getVirtualTexturePagesPerSide(i);
+        offset += pagesPerSide * pagesPerSide;
+    }
+    return offset;
+}
+
+uint32_t getVirtualTexturePagesPerSide(uint32_t mip) {
+    return VT_PAGES_PER_SIDE >> mip;
+}
+
+void getVirtualTexturePageCoords(uint32_t pageIndex, uint32_t* pMip, uint32_t* pX, uint32_t* pY) {
+    uint32_t mip = 0;
+    while (mip + 1 < VT_MIP_COUNT && pageIndex >= getVirtualTextureMipOffset(mip + 1)) {
+        mip++;
+    }
+
+    uint32_t local = pageIndex - getVirtualTextureMipOffset(mip);
+    *pMip = mip;
+    *pX = local % getVirtualTexturePagesPerSide(mip);
+    *pY = local / getVirtualTexturePagesPerSide(mip);
+}
+
+void initVirtualTexture(VirtualTexture* pTexture) {
+    memset(pTexture, 0, sizeof(*pTexture));
+
+    for (uint32_t i = 0; i < VT_PAGE_COUNT; ++i) {
+        pTexture->pages[i].slot = -1;
+    }
+    for (uint32_t i = 0; i < VT_POOL_SLOT_COUNT; ++i) {
+        pTexture->slotPages[i] = -1;
+    }
+    pTexture->pageTableDirty = true;
+}
+
+uint32_t processVirtualTextureFeedback(VirtualTexture* pTexture, const uint32_t* pRequests, uint32_t stamp, double now,
+                                       uint32_t* pPageIns, uint32_t maxCount) {
+    uint32_t pageInCount = 0;
+
+    // Pages are stored finest mip first, so walking backwards visits the coarse mips first.
+    for (uint32_t i = VT_PAGE_COUNT; i-- > 0;) {
+        if (pRequests[i] != stamp) {
+            continue;
+        }
+
+        VirtualTexturePage* pPage = &pTexture->pages[i];
+        pPage->lastRequestedStamp = stamp;
+        pTexture->stats.requestCount++;
+
+        if (pPage->slot >= 0) {
+            pTexture->stats.hitCount++;
+            continue;
+        }
+
+        if (pPage->requestTime == 0.0) {
+            pPage->requestTime = now;
+        }
+
+        if (pageInCount < maxCount) {
+            pPageIns[pageInCount++] = i;
+        }
+    }
+
+    return pageInCount;
+}
+
+int32_t allocateVirtualTextureSlot(VirtualTexture* pTexture, uint32_t pageIndex, uint32_t stamp, double now, int32_t* pEvictedPage) {
+    const uint32_t firstPinnedPage = getVirtualTextureMipOffset(VT_MIP_COUNT - 1);
+    int32_t slot = -1;
+    uint32_t oldestStamp = UINT32_MAX;
+
+    *pEvictedPage = -1;
+
+    for (int32_t i = 0; i < VT_POOL_SLOT_COUNT; ++i) {
+        int32_t residentPage = pTexture->slotPages[i];
+        if (residentPage < 0) {
+            slot = i;
+            break;
+        }
+
+        uint32_t lastRequested = pTexture->pages[residentPage].lastRequestedStamp;
+        if ((uint32_t) residentPage < firstPinnedPage && lastRequested != stamp && lastRequested < oldestStamp) {
+            oldestStamp = lastRequested;
+            slot = i;
+        }
+    }
+
+    if (slot < 0) {
+        return -1;
+    }
+
+    if (pTexture->slotPages[slot] >= 0) {
+        *pEvictedPage = pTexture->slotPages[slot];
+        pTexture->pages[*pEvictedPage].slot = -1;
+        pTexture->stats.evictionCount++;
+    }
+
+    VirtualTexturePage* pPage = &pTexture->pages[pageIndex];
+    pPage->slot = slot;
+    pTexture->slotPages[slot] = (int32_t) pageIndex;
+
+    if (pPage->requestTime != 0.0) {
+        double latency = now - pPage->requestTime;
+        pTexture->stats.totalLatency += latency;
+        if (latency > pTexture->stats.maxLatency) {
+            pTexture->stats.maxLatency = latency;
+        }
+        pPage->requestTime = 0.0;
+    }
+    pTexture->stats.pageInCount++;
+    pTexture->pageTableDirty = true;
+
+    return slot;
+}
+
+void buildVirtualTexturePageTable(VirtualTexture* pTexture) {
+    for (uint32_t mip = VT_MIP_COUNT; mip-- > 0;) {
+        uint32_t pagesPerSide = getVirtualTexturePagesPerSide(mip);
+        uint32_t mipOffset = getVirtualTextureMipOffset(mip);
+        uint32_t parentOffset = getVirtualTextureMipOffset(mip + 1);
+
+        for (uint32_t y = 0; y < pagesPerSide; ++y) {
+            for (uint32_t x = 0; x < pagesPerSide; ++x) {
+                uint32_t pageIndex = mipOffset + y * pagesPerSide + x;
+                int32_t slot = pTexture->pages[pageIndex].slot;
+
+                if (slot >= 0) {
+                    pTexture->pageTable[pageIndex] = (uint32_t) (slot % VT_POOL_SLOTS_PER_SIDE) |
+                                                     (uint32_t) (slot / VT_POOL_SLOTS_PER_SIDE) << 8 |
+                                                     mip << 16 | 0xFFu << 24;
+                } else if (mip + 1 < VT_MIP_COUNT) {
+                    pTexture->pageTable[pageIndex] = pTexture->pageTable[parentOffset + (y / 2) * (pagesPerSide / 2) + x / 2];
+                } else {
+                    pTexture->pageTable[pageIndex] = mip << 16;
+                }
+            }
+        }
+    }
+
+    pTexture->pageTableDirty = false;
+}
+
+static uint32_t hashCoords(uint32_t x, uint32_t y) {
+    uint32_t h = x * 0x8DA6B343u ^ y * 0xD8163841u;
+    h ^= h >> 13;
+    h *= 0x5BD1E995u;
+    return h ^ (h >> 15);
+}
+
+void generateVirtualTexturePage(uint32_t pageIndex, uint32_t border, uint8_t* pTexels) {
+    uint32_t mip, pageX, pageY;
+    getVirtualTexturePageCoords(pageIndex, &mip, &pageX, &pageY);
+
+    const int32_t size = VT_PAGE_SIZE + 2 * (int32_t) border;
+    const int32_t mipSize = VT_VIRTUAL_SIZE >> mip;
+
+    for (int32_t y = 0; y < size; ++y) {
+        for (int32_t x = 0; x < size; ++x) {
+            int32_t localX = x - (int32_t) border;
+            int32_t localY = y - (int32_t) border;
+            int32_t texelX = (int32_t) pageX * VT_PAGE_SIZE + localX;
+            int32_t texelY = (int32_t) pageY * VT_PAGE_SIZE + localY;
+            texelX = texelX < 0 ? 0 : texelX >= mipSize ? mipSize - 1 : texelX;
+            texelY = texelY < 0 ? 0 : texelY >= mipSize ? mipSize - 1 : texelY;
+
+            // Position in mip 0 texels so every mip shows the same picture.
+            uint32_t baseX = (uint32_t) texelX << mip;
+            uint32_t baseY = (uint32_t) texelY << mip;
+
+            // Coloured 2048 texel regions with a 64 texel checker that averages out once a texel covers a square.
+            uint32_t regionHash = hashCoords(baseX >> 11, baseY >> 11);
+            float brightness = mip >= 6 ? 0.8f : (((baseX >> 6) ^ (baseY >> 6)) & 1) ? 1.0f : 0.6f;
+
+            // Page edges are darkened so residency changes are visible.
+            bool pageEdge = localX == 0 || localY == 0;
+            if (pageEdge) {
+                brightness *= 0.5f;
+            }
+
+            uint8_t* pTexel = pTexels + ((size_t) y * size + x) * 4;
+            pTexel[0] = (uint8_t) ((float) (64 + (regionHash & 0xBF)) * brightness);
+            pTexel[1] = (uint8_t) ((float) (64 + ((regionHash >> 8) & 0xBF)) * brightness);
+            pTexel[2] = (uint8_t) ((float) (64 + ((regionHash >> 16) & 0xBF)) * brightness);
+            pTexel[3] = 255;
+        }
+    }
+}
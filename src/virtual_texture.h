@@ -0,0 +1,70 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A 16k x 16k RGBA8 virtual texture split into 128 texel pages over 8 mip levels. Only pages the GPU feedback asks
+// for are resident, in a pool with a fixed number of slots. The constants are mirrored in virtual_texture.frag.
+#define VT_VIRTUAL_SIZE 16384
+#define VT_PAGE_SIZE 128
+#define VT_MIP_COUNT 8
+#define VT_PAGES_PER_SIDE (VT_VIRTUAL_SIZE / VT_PAGE_SIZE)
+// Sum of (VT_PAGES_PER_SIDE >> mip)^2 over all mips.
+#define VT_PAGE_COUNT 21845
+
+// Pool slots carry a border so bilinear filtering never reads a neighbouring slot.
+#define VT_PAGE_BORDER 4
+#define VT_SLOT_SIZE (VT_PAGE_SIZE + 2 * VT_PAGE_BORDER)
+#define VT_POOL_SLOTS_PER_SIDE 16
+#define VT_POOL_SLOT_COUNT (VT_POOL_SLOTS_PER_SIDE * VT_POOL_SLOTS_PER_SIDE)
+
+#define VT_MAX_PAGE_INS_PER_FRAME 16
+
+typedef struct VirtualTexturePage {
+    int32_t slot;
+    uint32_t lastRequestedStamp;
+    // Time the page was first requested while not resident, 0 when there is no outstanding request.
+    double requestTime;
+} VirtualTexturePage;
+
+typedef struct VirtualTextureStats {
+    uint64_t requestCount;
+    uint64_t hitCount;
+    uint64_t pageInCount;
+    uint64_t evictionCount;
+    double totalLatency;
+    double maxLatency;
+} VirtualTextureStats;
+
+typedef struct VirtualTexture {
+    VirtualTexturePage pages[VT_PAGE_COUNT];
+    int32_t slotPages[VT_POOL_SLOT_COUNT];
+    // One RGBA8 entry per page, mips stored one after another: slot x, slot y, resident mip. Non resident pages
+    // point at their closest resident ancestor, the coarsest mip is always resident.
+    uint32_t pageTable[VT_PAGE_COUNT];
+    bool pageTableDirty;
+    VirtualTextureStats stats;
+} VirtualTexture;
+
+uint32_t getVirtualTextureMipOffset(uint32_t mip);
+uint32_t getVirtualTexturePagesPerSide(uint32_t mip);
+void getVirtualTexturePageCoords(uint32_t pageIndex, uint32_t* pMip, uint32_t* pX, uint32_t* pY);
+
+void initVirtualTexture(VirtualTexture* pTexture);
+
+// Consumes one frame of feedback, pRequests[page] == stamp for every page sampled that frame. Writes up to maxCount
+// missing pages to pPageIns, coarsest first so fallbacks improve before detail arrives, and returns the count.
+uint32_t processVirtualTextureFeedback(VirtualTexture* pTexture, const uint32_t* pRequests, uint32_t stamp, double now,
+                                       uint32_t* pPageIns, uint32_t maxCount);
+
+// Gives pageIndex a slot, evicting the least recently requested page if the pool is full. Pages requested in the
+// current frame and the coarsest mip are never evicted. Returns -1 when nothing can be evicted.
+int32_t allocateVirtualTextureSlot(VirtualTexture* pTexture, uint32_t pageIndex, uint32_t stamp, double now, int32_t* pEvictedPage);
+
+void buildVirtualTexturePageTable(VirtualTexture* pTexture);
+
+// Procedural stand-in for texture data read from disk. Fills a (VT_PAGE_SIZE + 2 * border)^2 RGBA8 block.
+void generateVirtualTexturePage(uint32_t pageIndex, uint32_t border, uint8_t* pTexels);
+
+#endif //VIRTUAL_TEXTURE_H
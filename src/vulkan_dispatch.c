@@ -0,0 +1,69 @@
+#include "vulkan_dispatch.h"
+
+#include <stdio.h>
+
+#include "platform.h"
+
+#define VULKAN_DEFINE_FUNCTION(name) PFN_##name name;
+PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+VULKAN_GLOBAL_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_INSTANCE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_DEVICE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+#undef VULKAN_DEFINE_FUNCTION
+
+static void* pLoaderLibrary;
+
+bool loadVulkanLoader() {
+    static const char* libraryNames[] = {
+#if defined(_WIN32)
+            "vulkan-1.dll",
+#elif defined(__APPLE__)
+            "libvulkan.1.dylib",
+            "libvulkan.dylib",
+            "libMoltenVK.dylib",
+#else
+            "libvulkan.so.1",
+            "libvulkan.so",
+#endif
+    };
+
+    for (size_t i = 0; i < sizeof(libraryNames) / sizeof(libraryNames[0]) && pLoaderLibrary == NULL; ++i) {
+        pLoaderLibrary = loadSharedLibrary(libraryNames[i]);
+    }
+    if (pLoaderLibrary == NULL) {
+        printf("%s - no Vulkan loader installed!\n", __FUNCTION__);
+        return false;
+    }
+
+    vkGetInstanceProcAddr = (PFN_vkGetInstanceProcAddr) getSharedLibrarySymbol(pLoaderLibrary, "vkGetInstanceProcAddr");
+    if (vkGetInstanceProcAddr == NULL) {
+        printf("%s - loader does not export vkGetInstanceProcAddr!\n", __FUNCTION__);
+        unloadVulkanLoader();
+        return false;
+    }
+
+#define VULKAN_LOAD_GLOBAL_FUNCTION(name) name = (PFN_##name) vkGetInstanceProcAddr(NULL, #name);
+    VULKAN_GLOBAL_FUNCTIONS(VULKAN_LOAD_GLOBAL_FUNCTION)
+#undef VULKAN_LOAD_GLOBAL_FUNCTION
+
+    return true;
+}
+
+void unloadVulkanLoader() {
+    if (pLoaderLibrary != NULL) {
+        unloadSharedLibrary(pLoaderLibrary);
+        pLoaderLibrary = NULL;
+    }
+}
+
+void loadInstanceFunctions(VkInstance instance) {
+#define VULKAN_LOAD_INSTANCE_FUNCTION(name) name = (PFN_##name) vkGetInstanceProcAddr(instance, #name);
+    VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD_INSTANCE_FUNCTION)
+#undef VULKAN_LOAD_INSTANCE_FUNCTION
+}
+
+void loadDeviceFunctions(VkDevice device) {
+#define VULKAN_LOAD_DEVICE_FUNCTION(name) name = (PFN_##name) vkGetDeviceProcAddr(device, #name);
+    VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_DEVICE_FUNCTION)
+#undef VULKAN_LOAD_DEVICE_FUNCTION
+}
@@ -0,0 +1,628 @@
+// Offline converter from Wavefront OBJ to the compact mesh container described in src/mesh_format.h.
+//
+// usage: mesh_convert input.obj output.mesh [--raw output.raw]
+//
+// --raw additionally writes the same mesh as plain float vertices and 32 bit indices, which is what the runtime
+// mesh benchmark compares against.
+
+#include "../src/mesh_format.h"
+#include "vertex_cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct ObjVertexKey {
+    int position;
+    int normal;
+} ObjVertexKey;
+
+typedef struct ConvertMesh {
+    uint32_t vertexCount;
+    MeshFloatVertex* pVertices;
+    uint32_t indexCount;
+    uint32_t* pIndices;
+    uint32_t meshletCount;
+    MeshletRange* pMeshlets;
+    MeshletBounds* pMeshletBounds;
+    uint32_t meshletVertexCount;
+    uint32_t* pMeshletVertices;
+    uint8_t* pMeshletTriangles;
+    float boundsMin[3];
+    float boundsMax[3];
+} ConvertMesh;
+
+typedef struct FloatArray {
+    float* pData;
+    uint32_t count;
+    uint32_t capacity;
+} FloatArray;
+
+typedef struct UintArray {
+    uint32_t* pData;
+    uint32_t count;
+    uint32_t capacity;
+} UintArray;
+
+static void pushFloat(FloatArray* pArray, float value) {
+    if (pArray->count == pArray->capacity) {
+        pArray->capacity = pArray->capacity == 0 ? 1024 : pArray->capacity * 2;
+        pArray->pData = realloc(pArray->pData, sizeof(float) * pArray->capacity);
+    }
+    pArray->pData[pArray->count++] = value;
+}
+
+static void pushUint(UintArray* pArray, uint32_t value) {
+    if (pArray->count == pArray->capacity) {
+        pArray->capacity = pArray->capacity == 0 ? 1024 : pArray->capacity * 2;
+        pArray->pData = realloc(pArray->pData, sizeof(uint32_t) * pArray->capacity);
+    }
+    pArray->pData[pArray->count++] = value;
+}
+
+// Open addressing map from (position, normal) index pairs to output vertices.
+typedef struct VertexMap {
+    ObjVertexKey* pKeys;
+    uint32_t* pValues;
+    uint32_t capacity;
+    uint32_t count;
+} VertexMap;
+
+static uint32_t hashVertexKey(ObjVertexKey key) {
+    uint32_t hash = (uint32_t) key.position * 0x9E3779B1u;
+    hash ^= (uint32_t) key.normal * 0x85EBCA77u;
+    hash ^= hash >> 15;
+    return hash;
+}
+
+static void growVertexMap(VertexMap* pMap) {
+    VertexMap grown = {
+            .capacity = pMap->capacity == 0 ? 4096 : pMap->capacity * 2,
+    };
+    grown.pKeys = malloc(sizeof(ObjVertexKey) * grown.capacity);
+    grown.pValues = malloc(sizeof(uint32_t) * grown.capacity);
+    for (uint32_t i = 0; i < grown.capacity; ++i) {
+        grown.pKeys[i].position = -1;
+    }
+
+    for (uint32_t i = 0; i < pMap->capacity; ++i) {
+        if (pMap->pKeys[i].position < 0)
+            continue;
+
+        uint32_t slot = hashVertexKey(pMap->pKeys[i]) & (grown.capacity - 1);
+        while (grown.pKeys[slot].position >= 0) {
+            slot = (slot + 1) & (grown.capacity - 1);
+        }
+        grown.pKeys[slot] = pMap->pKeys[i];
+        grown.pValues[slot] = pMap->pValues[i];
+        grown.count++;
+    }
+
+    free(pMap->pKeys);
+    free(pMap->pValues);
+    *pMap = grown;
+}
+
+// Returns true if the key was newly inserted with *pValue, otherwise stores the existing value in *pValue.
+static bool findOrInsertVertex(VertexMap* pMap, ObjVertexKey key, uint32_t* pValue) {
+    if ((pMap->count + 1) * 2 > pMap->capacity) {
+        growVertexMap(pMap);
+    }
+
+    uint32_t slot = hashVertexKey(key) & (pMap->capacity - 1);
+    while (pMap->pKeys[slot].position >= 0) {
+        if (pMap->pKeys[slot].position == key.position && pMap->pKeys[slot].normal == key.normal) {
+            *pValue = pMap->pValues[slot];
+            return false;
+        }
+        slot = (slot + 1) & (pMap->capacity - 1);
+    }
+
+    pMap->pKeys[slot] = key;
+    pMap->pValues[slot] = *pValue;
+    pMap->count++;
+    return true;
+}
+
+// OBJ indices are 1 based, negative values are relative to the end of the list so far. Returns false for 0 and for
+// indices outside the count elements read so far.
+static bool resolveObjIndex(int index, uint32_t count, int* pResolved) {
+    int64_t resolved = index < 0 ? (int64_t) count + index : (int64_t) index - 1;
+    if (index == 0 || resolved < 0 || resolved >= count) {
+        return false;
+    }
+    *pResolved = (int) resolved;
+    return true;
+}
+
+static bool loadObj(const char* filename, ConvertMesh* pMesh) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        printf("%s - file can't be opened! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    FloatArray positions = {};
+    FloatArray colors = {};
+    FloatArray normals = {};
+    UintArray indices = {};
+    UintArray vertexPositions = {};
+    UintArray vertexNormals = {};
+    VertexMap vertexMap = {};
+    bool hasColors = true;
+    bool validIndices = true;
+
+    char line[1024];
+    while (validIndices && fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == 'v' && line[1] == ' ') {
+            float x, y, z, r, g, b;
+            int count = sscanf(line + 2, "%f %f %f %f %f %f", &x, &y, &z, &r, &g, &b);
+            pushFloat(&positions, x);
+            pushFloat(&positions, y);
+            pushFloat(&positions, z);
+            hasColors = hasColors && count == 6;
+            pushFloat(&colors, count == 6 ? r : 1.0f);
+            pushFloat(&colors, count == 6 ? g : 1.0f);
+            pushFloat(&colors, count == 6 ? b : 1.0f);
+        } else if (line[0] == 'v' && line[1] == 'n') {
+            float x, y, z;
+            sscanf(line + 3, "%f %f %f", &x, &y, &z);
+            pushFloat(&normals, x);
+            pushFloat(&normals, y);
+            pushFloat(&normals, z);
+        } else if (line[0] == 'f' && line[1] == ' ') {
+            uint32_t faceVertices[64];
+            uint32_t faceVertexCount = 0;
+
+            char* pToken = strtok(line + 2, " \t\r\n");
+            while (pToken != NULL && faceVertexCount < 64) {
+                int position = 0, texcoord = 0, normal = 0;
+                bool hasNormal = sscanf(pToken, "%d/%d/%d", &position, &texcoord, &normal) == 3 ||
+                                 sscanf(pToken, "%d//%d", &position, &normal) == 2;
+                if (!hasNormal) {
+                    position = 0;
+                    sscanf(pToken, "%d", &position);
+                }
+
+                ObjVertexKey key = {.normal = -1};
+                if (!resolveObjIndex(position, positions.count / 3, &key.position) ||
+                    (hasNormal && !resolveObjIndex(normal, normals.count / 3, &key.normal))) {
+                    printf("%s - face index out of range! %s: %s\n", __FUNCTION__, filename, pToken);
+                    validIndices = false;
+                    break;
+                }
+                uint32_t vertexIndex = vertexPositions.count;
+                if (findOrInsertVertex(&vertexMap, key, &vertexIndex)) {
+                    pushUint(&vertexPositions, (uint32_t) key.position);
+                    pushUint(&vertexNormals, (uint32_t) key.normal);
+                }
+                faceVertices[faceVertexCount++] = vertexIndex;
+
+                pToken = strtok(NULL, " \t\r\n");
+            }
+
+            // Fan triangulate polygons.
+            for (uint32_t i = 2; i < faceVertexCount; ++i) {
+                pushUint(&indices, faceVertices[0]);
+                pushUint(&indices, faceVertices[i - 1]);
+                pushUint(&indices, faceVertices[i]);
+            }
+        }
+    }
+    fclose(file);
+
+    if (!validIndices) {
+        free(positions.pData);
+        free(colors.pData);
+        free(normals.pData);
+        free(indices.pData);
+        free(vertexPositions.pData);
+        free(vertexNormals.pData);
+        free(vertexMap.pKeys);
+        free(vertexMap.pValues);
+        return false;
+    }
+
+    if (indices.count == 0) {
+        printf("%s - no faces found! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    pMesh->vertexCount = vertexPositions.count;
+    pMesh->pVertices = calloc(pMesh->vertexCount, sizeof(MeshFloatVertex));
+    pMesh->indexCount = indices.count;
+    pMesh->pIndices = indices.pData;
+
+    for (uint32_t i = 0; i < pMesh->vertexCount; ++i) {
+        MeshFloatVertex* pVertex = &pMesh->pVertices[i];
+        memcpy(pVertex->position, &positions.pData[vertexPositions.pData[i] * 3], sizeof(float) * 3);
+        memcpy(pVertex->color, &colors.pData[vertexPositions.pData[i] * 3], sizeof(float) * 3);
+        if (vertexNormals.pData[i] != (uint32_t) -1) {
+            memcpy(pVertex->normal, &normals.pData[vertexNormals.pData[i] * 3], sizeof(float) * 3);
+        }
+    }
+
+    // Accumulate area weighted face normals for vertices the file gave no normal.
+    for (uint32_t i = 0; i < pMesh->indexCount; i += 3) {
+        MeshFloatVertex* v[3] = {&pMesh->pVertices[pMesh->pIndices[i]], &pMesh->pVertices[pMesh->pIndices[i + 1]], &pMesh->pVertices[pMesh->pIndices[i + 2]]};
+        float e1[3], e2[3];
+        for (int c = 0; c < 3; ++c) {
+            e1[c] = v[1]->position[c] - v[0]->position[c];
+            e2[c] = v[2]->position[c] - v[0]->position[c];
+        }
+        float faceNormal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        for (int k = 0; k < 3; ++k) {
+            if (vertexNormals.pData[pMesh->pIndices[i + k]] != (uint32_t) -1)
+                continue;
+            for (int c = 0; c < 3; ++c) {
+                v[k]->normal[c] += faceNormal[c];
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < pMesh->vertexCount; ++i) {
+        MeshFloatVertex* pVertex = &pMesh->pVertices[i];
+        float length = sqrtf(pVertex->normal[0] * pVertex->normal[0] + pVertex->normal[1] * pVertex->normal[1] + pVertex->normal[2] * pVertex->normal[2]);
+        for (int c = 0; c < 3; ++c) {
+            pVertex->normal[c] = length > 0.0f ? pVertex->normal[c] / length : (c == 2 ? 1.0f : 0.0f);
+            // Without vertex colours, visualise the normal.
+            if (!hasColors) {
+                pVertex->color[c] = pVertex->normal[c] * 0.5f + 0.5f;
+            }
+        }
+    }
+
+    free(positions.pData);
+    free(colors.pData);
+    free(normals.pData);
+    free(vertexPositions.pData);
+    free(vertexNormals.pData);
+    free(vertexMap.pKeys);
+    free(vertexMap.pValues);
+
+    return true;
+}
+
+static void computeBounds(ConvertMesh* pMesh) {
+    for (int c = 0; c < 3; ++c) {
+        pMesh->boundsMin[c] = INFINITY;
+        pMesh->boundsMax[c] = -INFINITY;
+    }
+
+    for (uint32_t i = 0; i < pMesh->vertexCount; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            pMesh->boundsMin[c] = fminf(pMesh->boundsMin[c], pMesh->pVertices[i].position[c]);
+            pMesh->boundsMax[c] = fmaxf(pMesh->boundsMax[c], pMesh->pVertices[i].position[c]);
+        }
+    }
+}
+
+static void buildMeshlets(ConvertMesh* pMesh) {
+    // Greedily cut the triangle stream into meshlets that fit MESHLET_MAX_VERTICES and MESHLET_MAX_TRIANGLES.
+    uint32_t* pVertexMeshlet = malloc(sizeof(uint32_t) * pMesh->vertexCount);
+    memset(pVertexMeshlet, 0xFF, sizeof(uint32_t) * pMesh->vertexCount);
+
+    uint32_t capacity = pMesh->indexCount / 3 / MESHLET_MAX_TRIANGLES + 16;
+    pMesh->pMeshlets = malloc(sizeof(MeshletRange) * capacity);
+    pMesh->meshletCount = 0;
+
+    MeshletRange current = {};
+    for (uint32_t i = 0; i < pMesh->indexCount; i += 3) {
+        uint32_t newVertices = 0;
+        for (int k = 0; k < 3; ++k) {
+            newVertices += pVertexMeshlet[pMesh->pIndices[i + k]] != pMesh->meshletCount;
+        }
+
+        if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.triangleCount == MESHLET_MAX_TRIANGLES) {
+            if (pMesh->meshletCount == capacity) {
+                capacity *= 2;
+                pMesh->pMeshlets = realloc(pMesh->pMeshlets, sizeof(MeshletRange) * capacity);
+            }
+            pMesh->pMeshlets[pMesh->meshletCount++] = current;
+            current = (MeshletRange) {.indexOffset = i};
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            uint32_t vertex = pMesh->pIndices[i + k];
+            if (pVertexMeshlet[vertex] != pMesh->meshletCount) {
+                pVertexMeshlet[vertex] = pMesh->meshletCount;
+                current.vertexCount++;
+            }
+        }
+        current.triangleCount++;
+    }
+
+    if (pMesh->meshletCount == capacity) {
+        pMesh->pMeshlets = realloc(pMesh->pMeshlets, sizeof(MeshletRange) * (capacity + 1));
+    }
+    pMesh->pMeshlets[pMesh->meshletCount++] = current;
+
+    free(pVertexMeshlet);
+}
+
+static void reorderVerticesByFirstUse(ConvertMesh* pMesh) {
+    // Vertices are fetched roughly in the order the index stream first touches them, so lay them out that way.
+    uint32_t* pRemap = malloc(sizeof(uint32_t) * pMesh->vertexCount);
+    memset(pRemap, 0xFF, sizeof(uint32_t) * pMesh->vertexCount);
+
+    MeshFloatVertex* pReordered = malloc(sizeof(MeshFloatVertex) * pMesh->vertexCount);
+    uint32_t nextVertex = 0;
+
+    for (uint32_t i = 0; i < pMesh->indexCount; ++i) {
+        uint32_t vertex = pMesh->pIndices[i];
+        if (pRemap[vertex] == (uint32_t) -1) {
+            pRemap[vertex] = nextVertex;
+            pReordered[nextVertex++] = pMesh->pVertices[vertex];
+        }
+        pMesh->pIndices[i] = pRemap[vertex];
+    }
+
+    // Unreferenced vertices are dropped.
+    free(pMesh->pVertices);
+    pMesh->pVertices = pReordered;
+    pMesh->vertexCount = nextVertex;
+
+    free(pRemap);
+}
+
+static void computeMeshletBounds(const MeshFloatVertex* pVertices, const uint32_t* pIndices, const MeshletRange* pMeshlet,
+                                 const uint32_t* pMeshletVertices, MeshletBounds* pBounds) {
+    float min[3] = {INFINITY, INFINITY, INFINITY};
+    float max[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (uint32_t i = 0; i < pMeshlet->vertexCount; ++i) {
+        const float* p = pVertices[pMeshletVertices[pMeshlet->vertexOffset + i]].position;
+        for (int c = 0; c < 3; ++c) {
+            min[c] = fminf(min[c], p[c]);
+            max[c] = fmaxf(max[c], p[c]);
+        }
+    }
+
+    float radiusSquared = 0.0f;
+    for (int c = 0; c < 3; ++c) {
+        pBounds->center[c] = (min[c] + max[c]) * 0.5f;
+    }
+    for (uint32_t i = 0; i < pMeshlet->vertexCount; ++i) {
+        const float* p = pVertices[pMeshletVertices[pMeshlet->vertexOffset + i]].position;
+        float dx = p[0] - pBounds->center[0], dy = p[1] - pBounds->center[1], dz = p[2] - pBounds->center[2];
+        radiusSquared = fmaxf(radiusSquared, dx * dx + dy * dy + dz * dz);
+    }
+    pBounds->radius = sqrtf(radiusSquared);
+
+    // Normal cone from the counter clockwise front faces.
+    float triangleNormals[MESHLET_MAX_TRIANGLES][3];
+    uint32_t normalCount = 0;
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+    for (uint32_t t = 0; t < pMeshlet->triangleCount; ++t) {
+        const uint32_t* pTriangle = &pIndices[pMeshlet->indexOffset + t * 3];
+        const float* p0 = pVertices[pTriangle[0]].position;
+        const float* p1 = pVertices[pTriangle[1]].position;
+        const float* p2 = pVertices[pTriangle[2]].position;
+        float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0f)
+            continue;
+
+        for (int c = 0; c < 3; ++c) {
+            triangleNormals[normalCount][c] = n[c] / length;
+            axis[c] += n[c] / length;
+        }
+        normalCount++;
+    }
+
+    float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float minDot = 1.0f;
+    for (int c = 0; c < 3; ++c) {
+        axis[c] = axisLength > 0.0f ? axis[c] / axisLength : 0.0f;
+        pBounds->coneAxis[c] = axis[c];
+    }
+    for (uint32_t i = 0; i < normalCount; ++i) {
+        minDot = fminf(minDot, triangleNormals[i][0] * axis[0] + triangleNormals[i][1] * axis[1] + triangleNormals[i][2] * axis[2]);
+    }
+
+    // Normals spread over more than a hemisphere, some triangle always faces the camera.
+    pBounds->coneCutoff = axisLength > 0.0f && minDot > 0.0f ? sqrtf(1.0f - minDot * minDot) : 1.0f;
+}
+
+static void buildMeshletData(ConvertMesh* pMesh) {
+    // Bounds are computed from what the GPU will actually see after quantisation.
+    MeshFloatVertex* pDecoded = malloc(sizeof(MeshFloatVertex) * pMesh->vertexCount);
+    for (uint32_t i = 0; i < pMesh->vertexCount; ++i) {
+        MeshPackedVertex packed;
+        packMeshVertex(pMesh->boundsMin, pMesh->boundsMax, &pMesh->pVertices[i], &packed);
+        unpackMeshVertex(pMesh->boundsMin, pMesh->boundsMax, &packed, &pDecoded[i]);
+    }
+
+    uint32_t* pVertexMeshlet = malloc(sizeof(uint32_t) * pMesh->vertexCount);
+    uint8_t* pLocalIndex = malloc(pMesh->vertexCount);
+    memset(pVertexMeshlet, 0xFF, sizeof(uint32_t) * pMesh->vertexCount);
+
+    pMesh->pMeshletBounds = malloc(sizeof(MeshletBounds) * pMesh->meshletCount);
+    pMesh->pMeshletVertices = malloc(sizeof(uint32_t) * pMesh->meshletCount * MESHLET_MAX_VERTICES);
+    pMesh->pMeshletTriangles = malloc(pMesh->indexCount);
+    pMesh->meshletVertexCount = 0;
+
+    for (uint32_t m = 0; m < pMesh->meshletCount; ++m) {
+        MeshletRange* pMeshlet = &pMesh->pMeshlets[m];
+        pMeshlet->vertexOffset = pMesh->meshletVertexCount;
+
+        uint32_t localCount = 0;
+        for (uint32_t i = pMeshlet->indexOffset; i < pMeshlet->indexOffset + pMeshlet->triangleCount * 3; ++i) {
+            uint32_t vertex = pMesh->pIndices[i];
+            if (pVertexMeshlet[vertex] != m) {
+                pVertexMeshlet[vertex] = m;
+                pLocalIndex[vertex] = (uint8_t) localCount++;
+                pMesh->pMeshletVertices[pMesh->meshletVertexCount++] = vertex;
+            }
+            pMesh->pMeshletTriangles[i] = pLocalIndex[vertex];
+        }
+
+        computeMeshletBounds(pDecoded, pMesh->pIndices, pMeshlet, pMesh->pMeshletVertices, &pMesh->pMeshletBounds[m]);
+    }
+
+    free(pLocalIndex);
+    free(pVertexMeshlet);
+    free(pDecoded);
+}
+
+static uint64_t alignSectionOffset(uint64_t offset) {
+    return (offset + MESH_SECTION_ALIGNMENT - 1) & ~(uint64_t) (MESH_SECTION_ALIGNMENT - 1);
+}
+
+static bool writeMeshFile(const char* filename, const ConvertMesh* pMesh) {
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("%s - file can't be opened! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    MeshFileHeader header = {
+            .magic = MESH_FILE_MAGIC,
+            .version = MESH_FILE_VERSION,
+            .vertexCount = pMesh->vertexCount,
+            .indexCount = pMesh->indexCount,
+            .meshletCount = pMesh->meshletCount,
+            .indexSize = pMesh->vertexCount <= 0x10000 ? 2 : 4,
+            .sectionCount = 6,
+    };
+    memcpy(header.boundsMin, pMesh->boundsMin, sizeof(header.boundsMin));
+    memcpy(header.boundsMax, pMesh->boundsMax, sizeof(header.boundsMax));
+
+    MeshPackedVertex* pPackedVertices = malloc(sizeof(MeshPackedVertex) * pMesh->vertexCount);
+    for (uint32_t i = 0; i < pMesh->vertexCount; ++i) {
+        packMeshVertex(pMesh->boundsMin, pMesh->boundsMax, &pMesh->pVertices[i], &pPackedVertices[i]);
+    }
+
+    void* pIndexData = pMesh->pIndices;
+    if (header.indexSize == 2) {
+        uint16_t* pShortIndices = malloc(sizeof(uint16_t) * pMesh->indexCount);
+        for (uint32_t i = 0; i < pMesh->indexCount; ++i) {
+            pShortIndices[i] = (uint16_t) pMesh->pIndices[i];
+        }
+        pIndexData = pShortIndices;
+    }
+
+    const void* pPayloads[] = {pPackedVertices, pIndexData, pMesh->pMeshlets, pMesh->pMeshletBounds, pMesh->pMeshletVertices, pMesh->pMeshletTriangles};
+    MeshFileSection sections[] = {
+            {.type = MESH_SECTION_VERTICES, .size = sizeof(MeshPackedVertex) * (uint64_t) pMesh->vertexCount},
+            {.type = MESH_SECTION_INDICES, .size = (uint64_t) header.indexSize * pMesh->indexCount},
+            {.type = MESH_SECTION_MESHLETS, .size = sizeof(MeshletRange) * (uint64_t) pMesh->meshletCount},
+            {.type = MESH_SECTION_MESHLET_BOUNDS, .size = sizeof(MeshletBounds) * (uint64_t) pMesh->meshletCount},
+            {.type = MESH_SECTION_MESHLET_VERTICES, .size = sizeof(uint32_t) * (uint64_t) pMesh->meshletVertexCount},
+            {.type = MESH_SECTION_MESHLET_TRIANGLES, .size = pMesh->indexCount},
+    };
+
+    uint64_t offset = alignSectionOffset(sizeof(MeshFileHeader) + sizeof(sections));
+    for (uint32_t i = 0; i < header.sectionCount; ++i) {
+        sections[i].offset = offset;
+        offset = alignSectionOffset(offset + sections[i].size);
+    }
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(sections, sizeof(sections), 1, file) == 1;
+    for (uint32_t i = 0; i < header.sectionCount && success; ++i) {
+        static const uint8_t padding[MESH_SECTION_ALIGNMENT] = {};
+        long position = ftell(file);
+        success = fwrite(padding, 1, sections[i].offset - position, file) == sections[i].offset - position &&
+                  fwrite(pPayloads[i], 1, sections[i].size, file) == sections[i].size;
+    }
+    fclose(file);
+
+    if (pIndexData != pMesh->pIndices) {
+        free(pIndexData);
+    }
+    free(pPackedVertices);
+
+    if (!success) {
+        printf("%s - failed to write file! %s\n", __FUNCTION__, filename);
+    }
+    return success;
+}
+
+static bool writeRawMeshFile(const char* filename, const ConvertMesh* pMesh) {
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("%s - file can't be opened! %s\n", __FUNCTION__, filename);
+        return false;
+    }
+
+    RawMeshHeader header = {
+            .magic = RAW_MESH_FILE_MAGIC,
+            .vertexCount = pMesh->vertexCount,
+            .indexCount = pMesh->indexCount,
+    };
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(pMesh->pVertices, sizeof(MeshFloatVertex), pMesh->vertexCount, file) == pMesh->vertexCount &&
+                   fwrite(pMesh->pIndices, sizeof(uint32_t), pMesh->indexCount, file) == pMesh->indexCount;
+    fclose(file);
+
+    if (!success) {
+        printf("%s - failed to write file! %s\n", __FUNCTION__, filename);
+    }
+    return success;
+}
+
+static float measureQuantisationError(const ConvertMesh* pMesh) {
+    float maxError = 0.0f;
+    for (uint32_t i = 0; i < pMesh->vertexCount; ++i) {
+        MeshPackedVertex packed;
+        MeshFloatVertex unpacked;
+        packMeshVertex(pMesh->boundsMin, pMesh->boundsMax, &pMesh->pVertices[i], &packed);
+        unpackMeshVertex(pMesh->boundsMin, pMesh->boundsMax, &packed, &unpacked);
+        for (int c = 0; c < 3; ++c) {
+            maxError = fmaxf(maxError, fabsf(unpacked.position[c] - pMesh->pVertices[i].position[c]));
+        }
+    }
+    return maxError;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("usage: %s input.obj output.mesh [--raw output.raw]\n", argv[0]);
+        return 1;
+    }
+
+    const char* rawFilename = NULL;
+    for (int i = 3; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "--raw") == 0) {
+            rawFilename = argv[i + 1];
+        }
+    }
+
+    ConvertMesh mesh = {};
+    if (!loadObj(argv[1], &mesh)) {
+        return 1;
+    }
+
+    float acmrBefore = computeAcmr(mesh.pIndices, mesh.indexCount, mesh.vertexCount, 16);
+    optimizeVertexCache(mesh.pIndices, mesh.indexCount, mesh.vertexCount);
+    float acmrAfter = computeAcmr(mesh.pIndices, mesh.indexCount, mesh.vertexCount, 16);
+    printf("%s - vertex cache ACMR (16 entry FIFO) %.3f before, %.3f after optimisation\n", __FUNCTION__, acmrBefore, acmrAfter);
+
+    buildMeshlets(&mesh);
+    reorderVerticesByFirstUse(&mesh);
+    computeBounds(&mesh);
+    buildMeshletData(&mesh);
+
+    if (!writeMeshFile(argv[2], &mesh)) {
+        return 1;
+    }
+
+    if (rawFilename != NULL && !writeRawMeshFile(rawFilename, &mesh)) {
+        return 1;
+    }
+
+    printf("%s - %u vertices, %u triangles, %u meshlets, max position error %g\n", __FUNCTION__,
+           mesh.vertexCount, mesh.indexCount / 3, mesh.meshletCount, measureQuantisationError(&mesh));
+
+    free(mesh.pVertices);
+    free(mesh.pIndices);
+    free(mesh.pMeshlets);
+    free(mesh.pMeshletBounds);
+    free(mesh.pMeshletVertices);
+    free(mesh.pMeshletTriangles);
+
+    return 0;
+}
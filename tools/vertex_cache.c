@@ -0,0 +1,188 @@
+#include "vertex_cache.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_SIZE 32
+#define VALENCE_TABLE_SIZE 32
+
+// Tuning constants from the original paper.
+static const float cacheDecayPower = 1.5f;
+static const float lastTriangleScore = 0.75f;
+static const float valenceBoostScale = 2.0f;
+static const float valenceBoostPower = 0.5f;
+
+static float cachePositionScores[CACHE_SIZE];
+static float valenceScores[VALENCE_TABLE_SIZE];
+
+static void initScoreTables() {
+    for (int i = 0; i < CACHE_SIZE; ++i) {
+        if (i < 3) {
+            // The three vertices of the last triangle get a fixed score so it isn't simply repeated.
+            cachePositionScores[i] = lastTriangleScore;
+        } else {
+            float scaler = 1.0f / (float) (CACHE_SIZE - 3);
+            cachePositionScores[i] = powf(1.0f - (float) (i - 3) * scaler, cacheDecayPower);
+        }
+    }
+
+    for (int i = 0; i < VALENCE_TABLE_SIZE; ++i) {
+        valenceScores[i] = i == 0 ? 0.0f : valenceBoostScale * powf((float) i, -valenceBoostPower);
+    }
+}
+
+static float vertexScore(int cachePosition, uint32_t remainingValence) {
+    if (remainingValence == 0) {
+        return -1.0f;
+    }
+
+    float score = cachePosition >= 0 ? cachePositionScores[cachePosition] : 0.0f;
+    // Boost vertices with few triangles left, so they get finished off rather than leaving lone triangles behind.
+    score += remainingValence < VALENCE_TABLE_SIZE ? valenceScores[remainingValence] : 0.0f;
+    return score;
+}
+
+void optimizeVertexCache(uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount) {
+    initScoreTables();
+
+    const uint32_t triangleCount = indexCount / 3;
+
+    // Adjacency: for each vertex the list of triangles using it.
+    uint32_t* pValence = calloc(vertexCount, sizeof(uint32_t));
+    uint32_t* pAdjacencyOffsets = calloc(vertexCount + 1, sizeof(uint32_t));
+    uint32_t* pAdjacency = malloc(sizeof(uint32_t) * indexCount);
+
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        pValence[pIndices[i]]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        pAdjacencyOffsets[v + 1] = pAdjacencyOffsets[v] + pValence[v];
+    }
+
+    uint32_t* pFill = calloc(vertexCount, sizeof(uint32_t));
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        uint32_t v = pIndices[i];
+        pAdjacency[pAdjacencyOffsets[v] + pFill[v]++] = i / 3;
+    }
+    free(pFill);
+
+    int* pCachePosition = malloc(sizeof(int) * vertexCount);
+    float* pVertexScores = malloc(sizeof(float) * vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        pCachePosition[v] = -1;
+        pVertexScores[v] = vertexScore(-1, pValence[v]);
+    }
+
+    float* pTriangleScores = malloc(sizeof(float) * triangleCount);
+    bool* pTriangleEmitted = calloc(triangleCount, sizeof(bool));
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        pTriangleScores[t] = pVertexScores[pIndices[t * 3]] + pVertexScores[pIndices[t * 3 + 1]] + pVertexScores[pIndices[t * 3 + 2]];
+    }
+
+    uint32_t* pOutput = malloc(sizeof(uint32_t) * indexCount);
+    uint32_t outputCount = 0;
+
+    uint32_t cache[CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+
+    uint32_t scanCursor = 0;
+    uint32_t bestTriangle = (uint32_t) -1;
+
+    while (outputCount < indexCount) {
+        if (bestTriangle == (uint32_t) -1) {
+            // Nothing in the cache neighbourhood, fall back to the next unemitted triangle in input order.
+            while (scanCursor < triangleCount && pTriangleEmitted[scanCursor]) {
+                scanCursor++;
+            }
+            bestTriangle = scanCursor;
+        }
+
+        pTriangleEmitted[bestTriangle] = true;
+        uint32_t triangleVertices[3];
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = pIndices[bestTriangle * 3 + k];
+            triangleVertices[k] = v;
+            pOutput[outputCount++] = v;
+
+            // Remove the emitted triangle from the vertex's remaining adjacency.
+            uint32_t* pList = &pAdjacency[pAdjacencyOffsets[v]];
+            for (uint32_t j = 0; j < pValence[v]; ++j) {
+                if (pList[j] == bestTriangle) {
+                    pList[j] = pList[pValence[v] - 1];
+                    break;
+                }
+            }
+            pValence[v]--;
+        }
+
+        // Push the triangle's vertices to the front of the LRU cache.
+        uint32_t newCache[CACHE_SIZE + 3];
+        uint32_t newCacheCount = 0;
+        for (int k = 0; k < 3; ++k) {
+            newCache[newCacheCount++] = triangleVertices[k];
+        }
+        for (uint32_t i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            if (v != triangleVertices[0] && v != triangleVertices[1] && v != triangleVertices[2]) {
+                newCache[newCacheCount++] = v;
+            }
+        }
+
+        // Rescore everything that was in the cache, including vertices that just fell out of it.
+        for (uint32_t i = 0; i < newCacheCount; ++i) {
+            uint32_t v = newCache[i];
+            pCachePosition[v] = i < CACHE_SIZE ? (int) i : -1;
+            pVertexScores[v] = vertexScore(pCachePosition[v], pValence[v]);
+        }
+
+        float bestScore = -1.0f;
+        bestTriangle = (uint32_t) -1;
+        for (uint32_t i = 0; i < newCacheCount; ++i) {
+            uint32_t v = newCache[i];
+            const uint32_t* pList = &pAdjacency[pAdjacencyOffsets[v]];
+            for (uint32_t j = 0; j < pValence[v]; ++j) {
+                uint32_t t = pList[j];
+                float score = pVertexScores[pIndices[t * 3]] + pVertexScores[pIndices[t * 3 + 1]] + pVertexScores[pIndices[t * 3 + 2]];
+                pTriangleScores[t] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        cacheCount = newCacheCount < CACHE_SIZE ? newCacheCount : CACHE_SIZE;
+        memcpy(cache, newCache, sizeof(uint32_t) * cacheCount);
+    }
+
+    memcpy(pIndices, pOutput, sizeof(uint32_t) * indexCount);
+
+    free(pOutput);
+    free(pTriangleEmitted);
+    free(pTriangleScores);
+    free(pVertexScores);
+    free(pCachePosition);
+    free(pAdjacency);
+    free(pAdjacencyOffsets);
+    free(pValence);
+}
+
+float computeAcmr(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+    // A FIFO of cacheSize entries, tracked by the time each vertex was last inserted.
+    uint32_t* pInsertTime = calloc(vertexCount, sizeof(uint32_t));
+    uint32_t time = 0;
+    uint32_t misses = 0;
+
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        uint32_t v = pIndices[i];
+        if (pInsertTime[v] == 0 || time - pInsertTime[v] >= cacheSize) {
+            pInsertTime[v] = ++time;
+            misses++;
+        }
+    }
+
+    free(pInsertTime);
+    return indexCount >= 3 ? (float) misses / (float) (indexCount / 3) : 0.0f;
+}
@@ -0,0 +1,14 @@
+#ifndef VERTEX_CACHE_H
+#define VERTEX_CACHE_H
+
+#include <stdint.h>
+
+// Reorders triangles in place for post-transform vertex cache locality, Tom Forsyth's "Linear-Speed Vertex Cache
+// Optimisation". Vertex indices themselves are unchanged.
+void optimizeVertexCache(uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount);
+
+// Average cache miss ratio (transformed vertices per triangle) through a simulated FIFO cache of cacheSize entries.
+// 3.0 is the worst case, around 0.5 to 0.7 is typical for well ordered regular meshes.
+float computeAcmr(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+
+#endif //VERTEX_CACHE_H